@@ -0,0 +1,97 @@
+#ifndef BITMAP_LIST_H
+#define BITMAP_LIST_H
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+// Roaring-style layout for dense posting lists (LIST_ENCODING_BITMAP). The docID space
+// is cut into chunks of 2^16; each chunk that has postings gets a container holding
+// the low 16 bits of its docIDs, either as a sorted array or as a 2^16-bit bitmap:
+//   BitmapChunk[chunkCount]   container offsets relative to the end of the table
+//   containers                uint16 values[cardinality] or uint64 words[BITMAP_CHUNK_WORDS]
+//   float scores[docFrequency] in docID order, at the end of the list
+const int BITMAP_CHUNK_BITS = 16;
+const int BITMAP_CHUNK_WORDS = (1 << BITMAP_CHUNK_BITS) / 64;
+// Chunks with more postings than this are stored as bitmaps (a bitmap is then smaller than the array)
+const uint32_t BITMAP_CONTAINER_MIN = 4096;
+// Lists use the bitmap layout when they have at least BITMAP_LIST_MIN_POSTINGS postings
+// covering at least 1/BITMAP_LIST_MIN_DENSITY of their docID span
+const int BITMAP_LIST_MIN_POSTINGS = 4096;
+const int BITMAP_LIST_MIN_DENSITY = 16;
+
+const uint16_t BITMAP_CONTAINER_ARRAY = 0;
+const uint16_t BITMAP_CONTAINER_BITMAP = 1;
+
+struct BitmapChunk {
+    uint16_t key;           // docID >> 16 of every posting in the chunk
+    uint16_t type;          // BITMAP_CONTAINER_ARRAY or BITMAP_CONTAINER_BITMAP
+    uint32_t cardinality;
+    uint32_t firstPosting;  // Index of the chunk's first posting in the list (for scores)
+    uint32_t offset;        // Start of the container, relative to the end of the chunk table
+};
+
+static_assert(sizeof(BitmapChunk) == 16, "BitmapChunk is stored as is in the index file");
+
+// Whether a docID-sorted posting list is dense enough for the bitmap layout
+bool preferBitmapEncoding(const std::vector<std::pair<int, float>> &postings);
+
+// Encode a docID-sorted posting list in the bitmap layout. Returns the number of chunks.
+int encodeBitmapList(const std::vector<std::pair<int, float>> &postings, std::vector<unsigned char> &out);
+
+// Forward cursor over a bitmap-encoded list. Lists sit at arbitrary byte offsets in the
+// mapped index, so every read goes through memcpy. Bitmap containers keep the rank of the
+// current posting incrementally (popcounts of the words passed over), which is all the
+// score lookup needs since cursors only move forward.
+class BitmapListCursor {
+public:
+    // Positioned before the first posting
+    void open(const unsigned char *list, int chunkCount, int docFrequency, int length);
+    bool next();
+    bool nextGEQ(int docID);
+    int docID() const { return currentDocID; }
+    float score() const {
+        float value;
+        std::memcpy(&value, scores + (chunk.firstPosting + consumed - 1) * sizeof(float), sizeof(float));
+        return value;
+    }
+    // Bitmap words of the current chunk, or nullptr if the chunk is an array container
+    const unsigned char *chunkBitmap() const {
+        return chunk.type == BITMAP_CONTAINER_BITMAP ? container : nullptr;
+    }
+
+private:
+    void enterChunk(int index);
+    bool nextInChunk();
+    bool seekInChunk(int low);
+    BitmapChunk chunkEntry(int index) const {
+        BitmapChunk entry;
+        std::memcpy(&entry, chunkTable + index * sizeof(BitmapChunk), sizeof(BitmapChunk));
+        return entry;
+    }
+    uint64_t word(int index) const {
+        uint64_t value;
+        std::memcpy(&value, container + index * sizeof(uint64_t), sizeof(uint64_t));
+        return value;
+    }
+    uint16_t arrayValue(uint32_t index) const {
+        uint16_t value;
+        std::memcpy(&value, container + index * sizeof(uint16_t), sizeof(uint16_t));
+        return value;
+    }
+
+    const unsigned char *chunkTable;
+    const unsigned char *containers;
+    const unsigned char *scores;
+    const unsigned char *container;  // Container of the current chunk
+    BitmapChunk chunk;               // Copy of the current chunk's entry
+    int chunkCount;
+    int chunkIndex;
+    int wordIndex;                   // Bitmap containers: word holding the current posting
+    uint64_t wordBits;               // Unvisited set bits of that word
+    uint32_t consumed;               // Postings of the chunk up to and including the current one
+    int currentDocID;
+};
+
+#endif // BITMAP_LIST_H
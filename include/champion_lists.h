@@ -0,0 +1,63 @@
+#ifndef CHAMPION_LISTS_H
+#define CHAMPION_LISTS_H
+
+#include <cstdint>
+#include <string>
+#include "mapped_file.h"
+
+// Precomputed top results of frequent terms. Every term with at least
+// CHAMPION_MIN_DOC_FREQUENCY postings gets its CHAMPION_LIST_SIZE best (docID, BM25
+// contribution) pairs, best first, so single-term queries need no list traversal.
+//   ChampionListsHeader
+//   slot       uint32[termCount], in lexicon term order: champion list of the term, or NO_CHAMPIONS
+//   lists      ChampionEntry[listSize] per term that has one
+const uint32_t CHAMPION_LISTS_MAGIC = 0x504D4843; // "CHMP"
+const uint32_t CHAMPION_LIST_SIZE = 10;
+const int32_t CHAMPION_MIN_DOC_FREQUENCY = 1024;
+const uint32_t NO_CHAMPIONS = UINT32_MAX;
+
+struct ChampionListsHeader {
+    uint32_t magic;
+    uint32_t termCount;
+    uint32_t listSize;
+    uint32_t listCount;
+};
+
+struct ChampionEntry {
+    int32_t docID;
+    float score;  // IDF * term frequency score, as the query processor computes it
+};
+
+static_assert(sizeof(ChampionEntry) == 8, "ChampionEntry is stored as is in the champion lists");
+
+// Champion lists live next to the lexicon ("lexicon.bin" -> "lexicon_champions.bin")
+std::string championListsFilename(const std::string &lexiconFilename);
+
+// Build the champion lists from a finished index and its lexicon
+bool buildChampionLists(const std::string &indexFilename, const std::string &lexiconFilename, const std::string &outputFilename);
+
+// Read-only view of the champion lists, used directly from the mapping
+class ChampionLists {
+public:
+    bool open(const std::string &filename);
+    void close() {
+        file.close();
+        header = nullptr;
+    }
+    bool isOpen() const { return header != nullptr; }
+    uint32_t termCount() const { return header ? header->termCount : 0; }
+    uint32_t listSize() const { return header ? header->listSize : 0; }
+    // Best postings of a term, best first (listSize() of them), or nullptr if it has none
+    const ChampionEntry *list(uint32_t termIndex) const {
+        uint32_t slot = slots[termIndex];
+        return slot == NO_CHAMPIONS ? nullptr : entries + static_cast<size_t>(slot) * header->listSize;
+    }
+
+private:
+    MappedFile file;
+    const ChampionListsHeader *header = nullptr;
+    const uint32_t *slots = nullptr;
+    const ChampionEntry *entries = nullptr;
+};
+
+#endif // CHAMPION_LISTS_H
@@ -0,0 +1,59 @@
+#ifndef DOC_TABLES_H
+#define DOC_TABLES_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "mapped_file.h"
+
+// Dense, docID-indexed document tables written by the indexer and mapped by the query processor.
+//
+// doc_lengths.bin:  DocLengthsHeader, int32 lengths[docCount]
+// page_table.bin:   PageTableHeader, then either
+//                   uint32 ids[docCount]                      if every doc name is a plain integer
+//                   uint64 offsets[docCount + 1], name blob    otherwise
+const uint32_t DOC_LENGTHS_MAGIC = 0x4E454C44; // "DLEN"
+const uint32_t PAGE_TABLE_MAGIC = 0x42415450;  // "PTAB"
+
+struct DocLengthsHeader {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t docCount;
+    uint64_t totalLength;  // Sum of all lengths, for the average document length
+};
+
+struct PageTableHeader {
+    uint32_t magic;
+    uint32_t numericNames;  // 1 if names are stored as uint32 ids
+    uint64_t docCount;
+};
+
+class DocLengthTable {
+public:
+    bool open(const std::string &filename);
+    uint64_t size() const { return header ? header->docCount : 0; }
+    double averageLength() const { return size() ? static_cast<double>(header->totalLength) / size() : 0.0; }
+    int length(int docID) const { return lengths[docID]; }
+
+private:
+    MappedFile file;
+    const DocLengthsHeader *header = nullptr;
+    const int32_t *lengths = nullptr;
+};
+
+class PageTable {
+public:
+    bool open(const std::string &filename);
+    uint64_t size() const { return header ? header->docCount : 0; }
+    // Name of a document. Numeric names are formatted into buffer, which must hold 16 chars.
+    std::string_view docName(int docID, char *buffer) const;
+
+private:
+    MappedFile file;
+    const PageTableHeader *header = nullptr;
+    const uint32_t *numericIDs = nullptr;
+    const uint64_t *nameOffsets = nullptr;
+    const char *nameBlob = nullptr;
+};
+
+#endif // DOC_TABLES_H
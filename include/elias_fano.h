@@ -0,0 +1,89 @@
+#ifndef ELIAS_FANO_H
+#define ELIAS_FANO_H
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+// Partitioned Elias-Fano layout for docIDs (LIST_ENCODING_ELIAS_FANO). The list is cut
+// into partitions whose boundaries are chosen to minimize the encoded size; each
+// partition stores its docIDs relative to the end of the previous one as an Elias-Fano
+// sequence (lowBits low bits per docID packed, the high parts in unary in the upper
+// bits), plus a sample of every EF_SELECT_SAMPLE-th zero of the upper bits so that a
+// cursor can find any high part with a constant amount of work.
+//   EliasFanoPartition[partitionCount]   offsets relative to the end of the table
+//   per partition: uint64 lower[], uint64 upper[], uint16 zeroSamples[]
+//   float scores[docFrequency] in docID order, at the end of the list
+const int EF_SELECT_SAMPLE = 64;
+// Partition boundaries are picked among multiples of EF_PARTITION_STEP postings,
+// and no partition is longer than EF_MAX_PARTITION postings
+const int EF_PARTITION_STEP = 64;
+const int EF_MAX_PARTITION = 4096;
+
+struct EliasFanoPartition {
+    int32_t maxDocID;       // Last docID of the partition
+    int32_t base;           // Values are stored as docID - base
+    uint32_t offset;        // Start of the partition data, relative to the end of the partition table
+    uint32_t firstPosting;  // Index of the partition's first posting in the list (for scores)
+    uint16_t count;
+    uint8_t lowBits;
+    uint8_t reserved;
+};
+
+static_assert(sizeof(EliasFanoPartition) == 20, "EliasFanoPartition is stored as is in the index file");
+
+// Encode a docID-sorted posting list in the partitioned Elias-Fano layout.
+// Returns the number of partitions.
+int encodeEliasFanoList(const std::vector<std::pair<int, float>> &postings, std::vector<unsigned char> &out);
+
+// Forward cursor over an Elias-Fano list. nextGEQ skips partitions through the
+// partition table and lands inside one with a sampled select on the upper bits, so it
+// never decodes the postings it jumps over.
+class EliasFanoCursor {
+public:
+    // Positioned before the first posting
+    void open(const unsigned char *list, int partitionCount, int docFrequency, int length);
+    bool next();
+    bool nextGEQ(int docID);
+    int docID() const { return currentDocID; }
+    float score() const {
+        float value;
+        std::memcpy(&value, scores + (partition.firstPosting + index) * sizeof(float), sizeof(float));
+        return value;
+    }
+
+private:
+    void enterPartition(int partitionIndex);
+    bool nextInPartition();
+    // Position the cursor just before the first element whose high part is >= high
+    void seekHigh(uint32_t high);
+    EliasFanoPartition partitionEntry(int partitionIndex) const {
+        EliasFanoPartition entry;
+        std::memcpy(&entry, partitionTable + partitionIndex * sizeof(EliasFanoPartition), sizeof(EliasFanoPartition));
+        return entry;
+    }
+    uint64_t upperWord(int wordIndex) const {
+        uint64_t value;
+        std::memcpy(&value, upper + wordIndex * sizeof(uint64_t), sizeof(uint64_t));
+        return value;
+    }
+    uint32_t lowerValue(int elementIndex) const;
+
+    const unsigned char *partitionTable;
+    const unsigned char *partitionData;
+    const unsigned char *scores;
+    const unsigned char *lower;     // Current partition's sections
+    const unsigned char *upper;
+    const unsigned char *zeroSamples;
+    EliasFanoPartition partition;   // Copy of the current partition's entry
+    int partitionCount;
+    int partitionIndex;
+    int index;                      // Current element of the partition, -1 before the first
+    int wordIndex;                  // Upper-bits word holding the current element
+    uint64_t wordBits;              // Unvisited set bits of that word
+    uint32_t currentHigh;
+    int currentDocID;
+};
+
+#endif // ELIAS_FANO_H
@@ -0,0 +1,49 @@
+#ifndef GRAPH_BISECTION_H
+#define GRAPH_BISECTION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "thread_pool.h"
+
+// DocID reordering by recursive graph bisection (BP, Dhulipala et al., KDD 2016): split the
+// documents in two, swap documents between the halves while that lowers the estimated cost
+// of the docID gaps of the terms they share, then recurse into each half. Documents sharing
+// terms end up with nearby docIDs, which shrinks the gaps the posting lists store.
+
+const int BISECTION_ITERATIONS = 20;
+const size_t BISECTION_MIN_PARTITION = 16;
+const size_t BISECTION_PARALLEL_MIN_DOCS = 4096;  // Smaller partitions are bisected on one thread
+
+// Document-term graph: the terms of document d are terms[offsets[d] .. offsets[d + 1])
+struct ForwardIndex {
+    uint32_t termCount = 0;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> terms;
+
+    size_t docCount() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+};
+
+struct BisectionOptions {
+    int iterations = BISECTION_ITERATIONS;
+    size_t minPartition = BISECTION_MIN_PARTITION;
+    int maxDepth = 0;  // 0: recurse until partitions reach minPartition
+    size_t parallelMinDocs = BISECTION_PARALLEL_MIN_DOCS;
+};
+
+// New document order: order[newID] = old docID
+std::vector<uint32_t> graphBisectionOrder(const ForwardIndex &graph, ThreadPool &pool,
+                                          const BisectionOptions &options = BisectionOptions());
+
+// Size of the docID gaps of every term when documents are numbered in the given order
+struct GapStats {
+    uint64_t postings = 0;
+    double logGapBits = 0;      // Sum of log2(gap + 1)
+    uint64_t varbyteBytes = 0;  // Gaps as varbytes
+
+    double bitsPerPosting() const { return postings ? logGapBits / postings : 0.0; }
+};
+
+GapStats computeGapStats(const ForwardIndex &graph, const std::vector<uint32_t> &order);
+
+#endif // GRAPH_BISECTION_H
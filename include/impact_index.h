@@ -0,0 +1,85 @@
+#ifndef IMPACT_INDEX_H
+#define IMPACT_INDEX_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "mapped_file.h"
+
+// Impact-ordered copy of the index for score-at-a-time processing. Every posting's BM25
+// contribution (IDF * term frequency score) is quantized to IMPACT_LEVELS levels over the
+// largest contribution in the collection, and each term's postings are grouped into
+// segments of equal impact, highest first:
+//   per term:  ImpactSegment[segmentCount], then per segment varbyte docIDs (first
+//              absolute, then gaps)
+//   directory  ImpactTermEntry[termCount], in lexicon term order
+//   ImpactIndexFooter at the very end
+// A posting's score is its impact times the footer's scale.
+const uint32_t IMPACT_INDEX_MAGIC = 0x58504D49; // "IMPX"
+const int IMPACT_LEVELS = 255;
+
+struct ImpactSegment {
+    uint16_t impact;
+    uint16_t reserved;
+    uint32_t count;   // Postings in the segment
+    uint32_t offset;  // Start of the docIDs, relative to the end of the segment table
+};
+
+struct ImpactTermEntry {
+    uint64_t offset;  // Start of the term's segment table
+    uint32_t segmentCount;
+    uint32_t reserved;
+};
+
+struct ImpactIndexFooter {
+    uint32_t magic;
+    uint32_t termCount;
+    uint64_t directoryOffset;
+    double scale;     // Score of one impact level
+};
+
+static_assert(sizeof(ImpactSegment) == 12, "ImpactSegment is stored as is in the impact index");
+static_assert(sizeof(ImpactTermEntry) == 16, "ImpactTermEntry is stored as is in the impact index");
+
+// The impact index lives next to the docID-ordered one ("index.bin" -> "impact_index.bin")
+std::string impactIndexFilename(const std::string &indexFilename);
+
+// Build the impact-ordered index from a finished docID-ordered index and its lexicon
+bool buildImpactIndex(const std::string &indexFilename, const std::string &lexiconFilename, const std::string &outputFilename);
+
+// Read-only view of an impact index, used directly from the mapping
+class ImpactIndex {
+public:
+    bool open(const std::string &filename);
+    void close() {
+        file.close();
+        opened = false;
+    }
+    bool isOpen() const { return opened; }
+    uint32_t termCount() const { return footer.termCount; }
+    double scale() const { return footer.scale; }
+    uint32_t segmentCount(uint32_t termIndex) const { return termEntry(termIndex).segmentCount; }
+    ImpactSegment segment(uint32_t termIndex, uint32_t segmentIndex) const {
+        ImpactSegment entry;
+        std::memcpy(&entry, file.data() + termEntry(termIndex).offset + segmentIndex * sizeof(ImpactSegment), sizeof(ImpactSegment));
+        return entry;
+    }
+    // Compressed docIDs of a segment
+    const unsigned char *segmentData(uint32_t termIndex, const ImpactSegment &segment) const {
+        ImpactTermEntry entry = termEntry(termIndex);
+        return file.data() + entry.offset + entry.segmentCount * sizeof(ImpactSegment) + segment.offset;
+    }
+
+private:
+    ImpactTermEntry termEntry(uint32_t termIndex) const {
+        ImpactTermEntry entry;
+        std::memcpy(&entry, file.data() + footer.directoryOffset + termIndex * sizeof(ImpactTermEntry), sizeof(ImpactTermEntry));
+        return entry;
+    }
+
+    MappedFile file;
+    ImpactIndexFooter footer = {};  // Copied out: the footer is not aligned in the file
+    bool opened = false;
+};
+
+#endif // IMPACT_INDEX_H
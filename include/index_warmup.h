@@ -0,0 +1,32 @@
+#ifndef INDEX_WARMUP_H
+#define INDEX_WARMUP_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Warming an index up from a sample query log: the terms of the logged queries, most
+// frequent first, are looked up in the lexicon and their posting lists read into memory
+// until the budget runs out, so the first real queries do not wait on the disk.
+
+// Default bound on the posting bytes read in
+const size_t WARMUP_BYTES = size_t(256) << 20;
+
+// Whichever runs out first ends the warmup; 0 means unlimited
+struct WarmupBudget {
+    size_t bytes = WARMUP_BYTES;
+    double milliseconds = 0;
+};
+
+struct WarmupStats {
+    size_t terms = 0;       // Terms whose lists were read in
+    size_t bytes = 0;
+    double milliseconds = 0;
+    bool complete = true;   // False if the budget ran out before the last term
+};
+
+// Normalized terms of a query log (one query per line; AND/OR mode lines are skipped),
+// most frequent first. Returns false if the log cannot be read.
+bool readWarmupTerms(const std::string &filename, std::vector<std::string> &terms);
+
+#endif // INDEX_WARMUP_H
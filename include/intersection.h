@@ -0,0 +1,32 @@
+#ifndef INTERSECTION_H
+#define INTERSECTION_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// First index in [begin, end) of a strictly increasing docID array with docIDs[i] >= target,
+// or end. Probes at doubling distances from begin, then binary searches the last bracket,
+// so short hops stay cheap and long ones cost O(log distance).
+inline int gallopGEQ(const int *docIDs, int begin, int end, int target) {
+    if (begin >= end || docIDs[begin] >= target) return begin;
+    int low = begin, step = 1, high = begin + 1;
+    while (high < end && docIDs[high] < target) {
+        low = high;
+        step <<= 1;
+        high = low + step;
+    }
+    if (high > end) high = end;
+    return static_cast<int>(std::lower_bound(docIDs + low + 1, docIDs + high, target) - docIDs);
+}
+
+// Intersect two strictly increasing docID arrays (normally two decoded blocks).
+// Writes the positions of each common docID in a and in b, in increasing order,
+// and returns how many there are. Both match arrays need room for min(aCount, bCount).
+size_t intersectBlocks(const int *a, size_t aCount, const int *b, size_t bCount, int *aMatches, int *bMatches);
+
+// AND two bitmap containers (BITMAP_CHUNK_WORDS words each, any alignment) into out.
+// Returns the number of docIDs in both.
+size_t andBitmapChunks(const unsigned char *a, const unsigned char *b, uint64_t *out);
+
+#endif // INTERSECTION_H
@@ -1,15 +1,27 @@
 #ifndef INVERTED_INDEX_H
 #define INVERTED_INDEX_H
 
-#include <fstream>
-#include <unordered_map>
 #include <string>
-#include <vector>
-#include "lexicon_entry.h"
+#include <string_view>
+#include "bitmap_list.h"
+#include "elias_fano.h"
+#include "lexicon.h"
+#include "mapped_file.h"
+#include "posting_list.h"
+#include "query_cache.h"
 
+// Lightweight cursor over one posting list. It only points at the lexicon record
+// and the mapped list; the decoded docIDs of the current block go into a buffer
+// supplied by the caller (normally from the query arena), so opening a list
+// neither copies metadata nor allocates. Lists in the bitmap or Elias-Fano layouts
+// are walked by an embedded BitmapListCursor or EliasFanoCursor instead.
+// With a block cache, decoded blocks of block-encoded lists are looked up by
+// (termIndex, block) before decoding and stored after.
 class InvertedListPointer {
 public:
-    InvertedListPointer(std::ifstream *indexFile, const LexiconEntry &lexEntry);
+    InvertedListPointer();
+    InvertedListPointer(const unsigned char *list, const LexiconRecord *record, int *docBuffer,
+                        BlockCache *blockCache = nullptr, uint32_t termIndex = 0);
     bool next();
     bool nextGEQ(int docID);
     int getDocID() const;
@@ -17,37 +29,75 @@ public:
     bool isValid() const;
     void close();
     float getIDF() const;
+    // Weigh the list with another IDF than its lexicon record's (segments use the IDF over all segments)
+    void setIDF(float value) { idf = value; }
+    int getDocFrequency() const;
+
+    int32_t getEncoding() const { return encoding; }
+    // Bitmap words of the current chunk of a bitmap list, or nullptr for array chunks
+    const unsigned char *chunkBitmap() const { return bitmap.chunkBitmap(); }
+
+    // Block-at-a-time access for the intersection kernels (block-encoded lists only): the
+    // decoded docIDs of the current block, the block size, and the current position inside it
+    const int *blockDocIDs() const { return docIDs; }
+    int blockSize() const { return blockPostings; }
+    int blockPosition() const { return position; }
+    // Move to another posting of the current block
+    void seekInBlock(int pos) {
+        position = pos;
+        currentDocID = docIDs[pos];
+    }
+    // Score of another posting of the current block
+    float blockScore(int pos) const;
+    // Move to the first posting of the next block
+    bool nextBlock();
+    // Block layout of a block-encoded list, for splitting the docID space at block boundaries
+    int blockCount() const { return record ? record->blockCount : 0; }
+    int blockMaxDocID(int blockIndex) const { return skipEntry(blockIndex).maxDocID; }
 
 private:
     void loadBlock(int blockIndex);
+    SkipEntry skipEntry(int blockIndex) const;
 
-    std::ifstream *indexFile;
-    LexiconEntry lexEntry;
+    const LexiconRecord *record;
+    const unsigned char *skipTable;   // Head of the list in the mapped index
+    const unsigned char *blockData;   // First block, right after the skip table
+    const unsigned char *termFreqScores;  // Scores of the current block (unaligned floats)
+    int *docIDs;                      // Decoded docIDs of the current block
+    int blockPostings;
+    int position;                     // Index of the current posting in the block
+    int currentBlockIndex;
     int currentDocID;
     bool valid;
-    int lastDocID;
-    size_t bufferPos;
-    std::vector<unsigned char> compressedData;
-    std::vector<float> termFreqScores;  // Added to store term frequency scores separately
-    float termFreqScoreValue;
-    int currentBlockIndex;
-    bool atBlockStart;
-    size_t termFreqScoreIndex;  // Added to track position in termFreqScores
+    float idf;
+    int32_t encoding;
+    BlockCache *blockCache;
+    uint32_t termIndex;
+    BitmapListCursor bitmap;
+    EliasFanoCursor eliasFano;
 };
 
 class InvertedIndex {
 public:
     InvertedIndex(const std::string &indexFilename, const std::string &lexiconFilename);
-    bool openList(const std::string &term);
-    InvertedListPointer getListPointer(const std::string &term);
-    void closeList(const std::string &term);
-    int getDocFrequency(const std::string &term);
 
-private:
-    std::ifstream indexFile;
-    std::unordered_map<std::string, LexiconEntry> lexicon;
+    // Index of the term's lexicon record, or -1 if it is not in the lexicon
+    int64_t findTerm(std::string_view term) const;
+    const LexiconRecord &getRecord(uint32_t termIndex) const;
+    // Open a cursor over a term's list; docBuffer must hold MAX_BLOCK_POSTINGS ints
+    InvertedListPointer openList(uint32_t termIndex, int *docBuffer) const;
+    int getDocFrequency(std::string_view term) const;
+    // Bring a term's list into memory (see MappedFile::prefetch); returns its size in bytes
+    size_t prefetchList(uint32_t termIndex) const;
+    uint32_t termCount() const { return lexicon.size(); }
+    bool isOpen() const { return indexFile.isOpen() && lexicon.isOpen(); }
+    // Cursors opened from now on share this cache of decoded blocks (nullptr for none)
+    void setBlockCache(BlockCache *cache) { blockCache = cache; }
 
-    void loadLexicon(const std::string &lexiconFilename);
+private:
+    MappedFile indexFile;
+    Lexicon lexicon;
+    BlockCache *blockCache = nullptr;
 };
 
 #endif // INVERTED_INDEX_H
@@ -0,0 +1,88 @@
+#ifndef LEXICON_H
+#define LEXICON_H
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "lexicon_entry.h"
+#include "mapped_file.h"
+#include "perfect_hash.h"
+
+// On-disk lexicon layout (all sections 8-byte aligned, used in place through mmap):
+//   LexiconHeader
+//   bucket index     uint32[bucketCount]      offset of each bucket in the term blob
+//   term blob        front-coded terms, LEXICON_BUCKET_SIZE per bucket; the first term
+//                    of a bucket is stored whole, the rest as (shared prefix, suffix)
+//   records          LexiconRecord[termCount] in term order
+// Block headers are not part of the lexicon; they sit in the skip table at the head of each list.
+const uint32_t LEXICON_MAGIC = 0x3358454C; // "LEX3"
+const uint32_t LEXICON_BUCKET_SIZE = 16;
+
+struct LexiconHeader {
+    uint32_t magic;
+    uint32_t bucketSize;
+    uint32_t termCount;
+    uint32_t bucketCount;
+    uint64_t bucketIndexOffset;
+    uint64_t termBlobOffset;
+    uint64_t recordOffset;
+};
+
+// Fixed-width per-term record
+struct LexiconRecord {
+    int64_t offset;       // Start of the posting list (skip table) in the index file
+    int32_t length;
+    int32_t docFrequency;
+    int32_t blockCount;
+    float IDF;
+    int32_t encoding;
+    int32_t reserved;
+};
+
+static_assert(sizeof(LexiconRecord) == 32, "LexiconRecord must stay fixed-width");
+
+// Collection size the IDFs are computed with (MS MARCO passages). Every segment uses the
+// same value, so a term's IDF only depends on its document frequency over all segments.
+const int64_t IDF_TOTAL_DOCUMENTS = 8841823;
+
+inline float bm25IDF(int64_t totalDocs, int64_t docFrequency) {
+    return std::log((totalDocs - docFrequency + 0.5) / (docFrequency + 0.5));
+}
+
+// The minimal perfect hash over the lexicon terms lives next to it ("lexicon.bin" -> "lexicon_mph.bin")
+std::string perfectHashFilename(const std::string &lexiconFilename);
+
+// Write a lexicon sorted by term. totalDocs is used to precompute IDF.
+void writeLexicon(const std::string &filename, std::vector<std::pair<std::string, LexiconEntry>> &lexicon, int64_t totalDocs);
+
+// Read-only view of a lexicon file, used directly from the mapping
+class Lexicon {
+public:
+    bool open(const std::string &filename);
+    bool isOpen() const { return header != nullptr; }
+
+    // Index of the term's record, or -1 if the term is not in the lexicon.
+    // Uses the perfect hash when it was found next to the lexicon, binary search otherwise.
+    int64_t find(std::string_view term) const;
+    int64_t findSorted(std::string_view term) const;
+    bool hasPerfectHash() const { return termHash.isOpen(); }
+    uint32_t size() const { return header ? header->termCount : 0; }
+    const LexiconRecord &record(uint32_t index) const { return records[index]; }
+    // Decode the term of a record (not meant for the query hot path)
+    std::string term(uint32_t index) const;
+
+private:
+    std::string_view firstTerm(uint32_t bucket) const;
+
+    MappedFile file;
+    PerfectHash termHash;
+    const LexiconHeader *header = nullptr;
+    const uint32_t *bucketIndex = nullptr;
+    const unsigned char *termBlob = nullptr;
+    const LexiconRecord *records = nullptr;
+};
+
+#endif // LEXICON_H
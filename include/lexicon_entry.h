@@ -1,29 +1,17 @@
 #ifndef LEXICON_ENTRY_H
 #define LEXICON_ENTRY_H
 
-#include <vector>
 #include <cstdint>
 
-// Lexicon entry structure
+// Lexicon entry structure. Block headers live in the skip table at the head of
+// each posting list in the index file (see posting_list.h).
 struct LexiconEntry {
-    int64_t offset;
-    int32_t length;
+    int64_t offset;        // Offset of the posting list (skip table first) in the index file
+    int32_t length;        // Length of the posting list including its skip table
     int32_t docFrequency;
-    int32_t blockCount;
-    std::vector<int32_t> blockMaxDocIDs;          // Maximum docID in each block
-    std::vector<int64_t> blockOffsets;            // Offset of each block in the index file
-    std::vector<size_t> blockCompressedDocIDLengths; // Length of compressed docIDs in each block
-    std::vector<int32_t> blockDocCounts;          // Number of postings in each block
+    int32_t blockCount;    // Blocks, bitmap chunks or Elias-Fano partitions, depending on the encoding
     float IDF;
-
-    // Method to get block length
-    size_t getBlockLength(int blockIndex) const {
-        if (blockIndex < blockCount - 1) {
-            return blockOffsets[blockIndex + 1] - blockOffsets[blockIndex];
-        } else {
-            return (offset + length) - blockOffsets[blockIndex];
-        }
-    }
+    int32_t encoding;      // LIST_ENCODING_* in posting_list.h
 };
 
 #endif // LEXICON_ENTRY_H
@@ -0,0 +1,60 @@
+// logger.h
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <string>
+#include <string_view>
+
+// Leveled asynchronous log. A call copies the message and a steady-clock timestamp into a
+// lock-free ring owned by the calling thread; a background thread drains the rings every
+// LOG_DRAIN_MILLISECONDS, orders the records by time and writes them to the log file. So a
+// log call never takes a lock or touches the file, and costs nothing below the level.
+enum LogLevel {
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_OFF,
+};
+
+// Levels below this are compiled out (e.g. -DLOG_MIN_LEVEL=LOG_LEVEL_INFO); the rest are
+// filtered at run time by setLogLevel
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// Records per thread ring; a full ring drops debug and info messages, warnings and errors
+// wait for room
+const size_t LOG_RING_RECORDS = 1024;
+// Longer messages are cut to this many bytes
+const size_t LOG_RECORD_TEXT = 240;
+const int LOG_DRAIN_MILLISECONDS = 100;
+
+// Open the log file (appending) and start the drain thread. Until then, and after
+// stopLogging, log calls do nothing.
+bool startLogging(const std::string &filename, LogLevel level = LOG_LEVEL_INFO);
+// Write out what is queued and close the file; done at exit too
+void stopLogging();
+void setLogLevel(LogLevel level);
+// "debug", "info", "warn", "error" or "off"
+bool parseLogLevel(std::string_view name, LogLevel &level);
+
+extern std::atomic<int> logThreshold;  // Lowest level written; LOG_LEVEL_OFF while stopped
+
+inline bool logEnabled(LogLevel level) {
+    return level >= LOG_MIN_LEVEL && level >= logThreshold.load(std::memory_order_relaxed);
+}
+void logWrite(LogLevel level, std::string_view message);
+
+// The message expression is only evaluated when its level is on
+#define LOG_AT(level, message)                           \
+    do {                                                 \
+        if (logEnabled(level)) logWrite(level, message); \
+    } while (0)
+#define LOG_DEBUG(message) LOG_AT(LOG_LEVEL_DEBUG, message)
+#define LOG_INFO(message) LOG_AT(LOG_LEVEL_INFO, message)
+#define LOG_WARN(message) LOG_AT(LOG_LEVEL_WARN, message)
+#define LOG_ERROR(message) LOG_AT(LOG_LEVEL_ERROR, message)
+
+#endif // LOGGER_H
@@ -0,0 +1,29 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &filename);
+    void close();
+    bool isOpen() const { return mapping != nullptr; }
+    const unsigned char *data() const { return static_cast<const unsigned char *>(mapping); }
+    size_t size() const { return length; }
+    // Read a byte range into memory ahead of use: the kernel is asked to read it all in at
+    // once, then its pages are touched so they are resident on return. Returns the bytes.
+    size_t prefetch(size_t offset, size_t bytes) const;
+
+private:
+    void *mapping = nullptr;
+    size_t length = 0;
+};
+
+#endif // MAPPED_FILE_H
@@ -11,6 +11,11 @@
 // Function prototypes
 void mergeTempFiles(int numFiles);
 
-void logMessage(const std::string &message);
+// Encode a posting list in the layout the merger picks for it; the entry's offset is left at 0
+LexiconEntry encodePostings(const std::vector<std::pair<int, float>> &postingsList, std::vector<unsigned char> &encodedList);
+// Write directory/lexicon.bin and its perfect hash
+void writeLexiconToFile(std::vector<std::pair<std::string, LexiconEntry>> &lexicon, const std::string &directory);
+// Champion lists, and the impact and tier-1 indexes when asked for, of directory's index
+void buildDerivedIndexes(const std::string &directory);
 
 #endif  // MERGER_H
@@ -8,10 +8,10 @@
 #include <atomic>
 #include "utils.h"
 
-class ThreadPool;
-
-void generateTermDocPairsMT(const std::string &inputFile, std::unordered_map<int, std::string> &pageTable, ThreadPool *threadPool, std::unordered_map<int, int> &docLengths, std::mutex &docLengthsMutex);
-
-void processPassageMT(int docID, const std::string &passage, std::vector<TermDocPair> &termDocPairs, std::mutex &termDocPairsMutex, std::atomic<int> &fileCounter, std::unordered_map<int, int> &docLengths, std::mutex &docLengthsMutex);
+// Parse the collection with a reader, tokenizerCount tokenizer threads and an inverter
+// feeding the spill writer; queueDepth bounds the lines and documents between stages.
+// Temp runs go to runDirectory.
+void generateTermDocPairsMT(const std::string &inputFile, std::unordered_map<int, std::string> &pageTable, size_t tokenizerCount, size_t queueDepth, std::unordered_map<int, int> &docLengths,
+                            const std::string &runDirectory = "../data/intermediate");
 
 #endif  // PARSER_AND_INDEXER_MT_H
@@ -0,0 +1,57 @@
+#ifndef PERFECT_HASH_H
+#define PERFECT_HASH_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "mapped_file.h"
+
+// Minimal perfect hash over the final vocabulary (hash-and-displace with one
+// pilot per bucket of ~4 keys). Each slot keeps a 32-bit fingerprint of the key
+// so that terms outside the vocabulary are rejected without comparing strings.
+//
+// File layout: PerfectHashHeader, uint32 pilots[bucketCount], PerfectHashSlot slots[keyCount]
+// A key's slot is fastRange(fmix64(hash ^ pilotHash(pilot, seed)), keyCount); MPH1 files,
+// which left out the fmix64, are rejected and the lexicon falls back to binary search.
+const uint32_t PERFECT_HASH_MAGIC = 0x3248504D; // "MPH2"
+
+struct PerfectHashHeader {
+    uint32_t magic;
+    uint32_t keyCount;
+    uint32_t bucketCount;
+    uint32_t reserved;
+    uint64_t seed;
+};
+
+struct PerfectHashSlot {
+    uint32_t fingerprint;
+    uint32_t value;       // Index of the key in the vocabulary (= lexicon record index)
+};
+
+uint64_t hashTerm(std::string_view term, uint64_t seed);
+
+// Build the hash for keys (value of keys[i] is i) and write it to filename
+bool buildPerfectHash(const std::vector<std::string_view> &keys, const std::string &filename);
+
+class PerfectHash {
+public:
+    bool open(const std::string &filename);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+    uint32_t keyCount() const { return header ? header->keyCount : 0; }
+    // Seed the build settled on (1 unless the first ones failed)
+    uint64_t seed() const { return header ? header->seed : 0; }
+    // Value stored for key, or -1 if the fingerprint does not match
+    int64_t find(std::string_view key) const;
+
+private:
+    uint64_t slotOf(uint64_t hash) const;
+
+    MappedFile file;
+    const PerfectHashHeader *header = nullptr;
+    const uint32_t *pilots = nullptr;
+    const PerfectHashSlot *slots = nullptr;
+};
+
+#endif // PERFECT_HASH_H
@@ -0,0 +1,44 @@
+#ifndef POSTING_LIST_H
+#define POSTING_LIST_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Posting list encodings (LexiconRecord::encoding). Dense lists use the bitmap layout in
+// bitmap_list.h; the merger can store the others as partitioned Elias-Fano (elias_fano.h).
+const int32_t LIST_ENCODING_BLOCKS = 0;
+const int32_t LIST_ENCODING_BITMAP = 1;
+const int32_t LIST_ENCODING_ELIAS_FANO = 2;
+
+// Block sizes are chosen per list. Blocks aim at BLOCK_SIZE postings, or LONG_LIST_BLOCK_SIZE
+// for lists longer than LONG_LIST_POSTINGS so that skipping and block maxima stay fine-grained.
+// A block may be anywhere from half to twice its target; the cut goes at the largest docID gap
+// in that window when it is at least BLOCK_GAP_FACTOR times the list's average gap, so blocks
+// follow clusters of docIDs and nextGEQ can skip the gaps between them.
+const int BLOCK_SIZE = 128;
+const int LONG_LIST_BLOCK_SIZE = 64;
+const int LONG_LIST_POSTINGS = 1 << 16;
+const int BLOCK_GAP_FACTOR = 8;
+// Upper bound on postings in any block, used to size decode buffers. Lists this short are
+// stored as a single block.
+const int MAX_BLOCK_POSTINGS = 2 * BLOCK_SIZE;
+
+// Posting list layout in the index file:
+//   SkipEntry[blockCount]   skip table, offsets relative to the end of the table
+//   per block: varbyte docIDs (first absolute, then gaps), float term frequency scores
+// Single-block lists have no skip table: the block starts the list and its scores end it.
+struct SkipEntry {
+    int32_t maxDocID;
+    uint32_t offset;      // Start of the block, relative to the end of the skip table
+    uint16_t docIDBytes;  // Length of the compressed docIDs
+    uint16_t docCount;    // Number of postings in the block
+};
+
+static_assert(sizeof(SkipEntry) == 12, "SkipEntry is stored as is in the index file");
+
+// Encode a docID-sorted posting list (docID, term frequency score) into out.
+// Returns the number of blocks.
+int encodePostingList(const std::vector<std::pair<int, float>> &postings, std::vector<unsigned char> &out);
+
+#endif // POSTING_LIST_H
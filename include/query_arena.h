@@ -0,0 +1,51 @@
+#ifndef QUERY_ARENA_H
+#define QUERY_ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Bump allocator for per-query scratch memory (cursors, block buffers, top-k heap).
+// reset() rewinds it without freeing, so after the first few queries a thread's
+// arena has all the chunks it needs and the query path stops touching the heap.
+// Only trivially destructible objects belong here: nothing is ever destroyed.
+class QueryArena {
+public:
+    explicit QueryArena(size_t chunkSize = 1 << 16);
+    ~QueryArena();
+    QueryArena(const QueryArena &) = delete;
+    QueryArena &operator=(const QueryArena &) = delete;
+
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    template <typename T>
+    T *allocateArray(size_t count) {
+        return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    template <typename T, typename... Args>
+    T *create(Args &&...args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Make all memory available again, keeping the chunks
+    void reset();
+    size_t chunkCount() const { return chunks.size(); }
+
+    // Arena of the calling thread
+    static QueryArena &local();
+
+private:
+    struct Chunk {
+        char *data;
+        size_t size;
+    };
+
+    std::vector<Chunk> chunks;
+    size_t chunkSize;
+    size_t current;  // Chunk being bumped
+    size_t used;     // Bytes used in the current chunk
+};
+
+#endif // QUERY_ARENA_H
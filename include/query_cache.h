@@ -0,0 +1,73 @@
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include "posting_list.h"
+#include "tiny_lfu_cache.h"
+#include "top_k.h"
+
+// Queries with more terms or a larger k than this are not cached
+const size_t RESULT_CACHE_MAX_TERMS = 8;
+const size_t RESULT_CACHE_MAX_K = 10;
+
+inline uint64_t hashWords(const uint32_t *words, size_t count) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < count; ++i) {
+        hash = (hash ^ words[i]) * 0x100000001B3ULL;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+// First level: results of a query, keyed by its normalized terms (as lexicon indices, in
+// query order since that fixes how scores are summed), the mode and k
+struct ResultCacheKey {
+    uint32_t terms[RESULT_CACHE_MAX_TERMS];
+    uint32_t termCount;
+    uint32_t conjunctive;
+    uint32_t k;
+
+    uint64_t hash() const { return hashWords(terms, RESULT_CACHE_MAX_TERMS + 3); }
+    bool operator==(const ResultCacheKey &other) const { return std::memcmp(this, &other, sizeof(*this)) == 0; }
+};
+
+struct CachedResults {
+    uint64_t version = 0;  // Tombstones version the results were computed under
+    uint32_t count = 0;
+    SearchResult results[RESULT_CACHE_MAX_K];
+};
+
+// Results of a query over several segments. Every segment has its own lexicon, so the key
+// holds the found terms' text (in query order, each ended by a 0 byte) rather than lexicon
+// indices, with the mode and k; longer queries are not cached. Each generation of segments
+// has its own cache.
+const size_t SEGMENT_CACHE_TERM_WORDS = 24;
+struct SegmentResultCacheKey {
+    uint32_t terms[SEGMENT_CACHE_TERM_WORDS];
+    uint32_t conjunctive;
+    uint32_t k;
+
+    uint64_t hash() const { return hashWords(terms, SEGMENT_CACHE_TERM_WORDS + 2); }
+    bool operator==(const SegmentResultCacheKey &other) const { return std::memcmp(this, &other, sizeof(*this)) == 0; }
+};
+
+// Second level: decoded docIDs of a posting block
+struct BlockCacheKey {
+    uint32_t term;
+    uint32_t block;
+
+    uint64_t hash() const { return hashWords(&term, 2); }
+    bool operator==(const BlockCacheKey &other) const { return term == other.term && block == other.block; }
+};
+
+struct CachedBlock {
+    int count = 0;
+    int docIDs[MAX_BLOCK_POSTINGS];
+};
+
+typedef TinyLfuCache<ResultCacheKey, CachedResults> ResultCache;
+typedef TinyLfuCache<BlockCacheKey, CachedBlock> BlockCache;
+typedef TinyLfuCache<SegmentResultCacheKey, CachedResults> SegmentResultCache;
+
+#endif // QUERY_CACHE_H
@@ -2,27 +2,146 @@
 #ifndef QUERY_PROCESSOR_H
 #define QUERY_PROCESSOR_H
 #include "inverted_index.h"
-#include "lexicon_entry.h"
+#include "doc_tables.h"
+#include "impact_index.h"
+#include "tier1_index.h"
+#include "champion_lists.h"
+#include "query_cache.h"
+#include "thread_pool.h"
+#include "query_arena.h"
+#include "top_k.h"
+#include "tombstones.h"
+#include <atomic>
+#include <memory>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 #include <cstdint>
 #include <fstream>
+#include <iostream>
+
+// How OR queries walk their lists; AND queries always go document at a time
+enum Traversal {
+    TRAVERSAL_AUTO,  // Pick per query from the list lengths
+    TRAVERSAL_DAAT,
+    TRAVERSAL_TAAT,
+    TRAVERSAL_SAAT,  // Score at a time over the impact-ordered index, within the query budget
+};
+
+// Use of the tier-1 index for OR queries, when one was built
+enum TierMode {
+    TIER_SAFE,         // Answer from tier 1 when that provably gives the exact top-k, else use the full index
+    TIER_APPROXIMATE,  // Always answer from tier 1
+    TIER_OFF,
+};
+
+// Work allowed per score-at-a-time query; 0 means unlimited. Processing stops at whichever
+// runs out first and returns the best documents found so far.
+struct QueryBudget {
+    size_t postings = 0;
+    double milliseconds = 0;
+};
+
+// OR queries switch to term-at-a-time once their lists hold at least one posting
+// per TAAT_MIN_DENSITY documents, where clearing and scanning accumulator pages pays off
+const int TAAT_MIN_DENSITY = 8;
+
+// OR queries over at least this many postings are split into docID ranges when
+// intra-query parallelism is on (setParallelism)
+const int64_t PARALLEL_MIN_POSTINGS = 1 << 20;
+
+// Default cache sizes; see setCacheSizes
+const size_t RESULT_CACHE_BYTES = 16 << 20;
+const size_t BLOCK_CACHE_BYTES = 16 << 20;
 
 class QueryProcessor {
 public:
-    QueryProcessor(const std::string &indexFilename, const std::string &lexiconFilename, const std::string &pageTableFilename, const std::string &docLengthsFilename);
+    // What the index holds is reported on messages
+    QueryProcessor(const std::string &indexFilename, const std::string &lexiconFilename, const std::string &pageTableFilename, const std::string &docLengthsFilename,
+                   std::ostream &messages = std::cout);
+    // Whether the index and document tables were all opened
+    bool isOpen() const { return invertedIndex.isOpen() && docLengths.size() > 0 && pageTable.size() == docLengths.size(); }
+    // Run a query and print the top 10 results
     void processQuery(const std::string &query, bool conjunctive);
+    // Run a query into results (room for k entries), best first. Returns the number of results.
+    // Scratch memory comes from the calling thread's arena, so this does not allocate in steady state.
+    size_t search(std::string_view query, bool conjunctive, size_t k, SearchResult *results);
+    // Run a query the caller has already parsed (into the thread's arena), weighing term i with
+    // termIDFs[i] instead of this index's own IDF. Used to search one segment of several: a term
+    // missing here matches nothing, so an AND query with such a term has no results here.
+    // Champion lists, the tier-1 and the impact index hold scores built with the segment's own
+    // IDFs and are not used on this path.
+    size_t searchTerms(const std::string_view *terms, const float *termIDFs, size_t termCount, bool conjunctive, size_t k, SearchResult *results);
+    // Split and normalize the query into terms stored in the arena
+    static size_t parseQuery(std::string_view query, QueryArena &arena, std::string_view *&terms);
+    int getDocFrequency(std::string_view term) const { return invertedIndex.getDocFrequency(term); }
+    std::string_view docName(int docID, char *buffer) const { return pageTable.docName(docID, buffer); }
+    // Look the term up and bring its posting list into memory. Returns the list's size in
+    // bytes, 0 if the term is not in the lexicon.
+    size_t prefetchTerm(std::string_view term) const {
+        int64_t termIndex = invertedIndex.findTerm(term);
+        return termIndex < 0 ? 0 : invertedIndex.prefetchList(static_cast<uint32_t>(termIndex));
+    }
+    // Changing how queries are evaluated drops the cached results
+    void setTraversal(Traversal mode) {
+        traversal = mode;
+        resultCache.clear();
+    }
+    void setBudget(const QueryBudget &limits) {
+        budget = limits;
+        resultCache.clear();
+    }
+    void setTierMode(TierMode mode) {
+        tierMode = mode;
+        resultCache.clear();
+    }
+    bool hasImpactIndex() const { return impactIndex.isOpen(); }
+    // Bumped by every delete in this index, for callers that cache its results
+    uint64_t deletionsVersion() const { return tombstones.version(); }
+    // Whether search prints the query terms missing from the lexicon (on by default)
+    void setReportMissingTerms(bool report) { reportMissingTerms = report; }
+    // Byte bounds of the result cache and the decoded block cache; 0 turns one off
+    void setCacheSizes(size_t resultBytes, size_t blockBytes);
+    // Run heavy OR queries on up to threads cores, one docID range each (1 turns this off).
+    // The helper ranges run on pool, which may be shared with other processors, or on a
+    // pool of threads - 1 workers of this processor's own when none is given.
+    void setParallelism(size_t threads, int64_t minPostings = PARALLEL_MIN_POSTINGS, std::shared_ptr<ThreadPool> pool = nullptr);
+    CacheStats resultCacheStats() { return resultCache.stats(); }
+    CacheStats blockCacheStats() { return blockCache.stats(); }
+
 private:
     InvertedIndex invertedIndex;
-    std::unordered_map<int, std::string> pageTable; // docID -> docName
-    std::unordered_map<int, int> docLengths;        // docID -> docLength
+    ImpactIndex impactIndex;      // Optional, for score-at-a-time queries
+    Tier1Index tier1;             // Optional pruned first tier, held in memory
+    ChampionLists champions;      // Top postings of frequent terms, mapped
+    PageTable pageTable;          // docID -> docName, mapped
+    DocLengthTable docLengths;    // docID -> docLength, mapped
+    Tombstones tombstones;        // Deleted docIDs, mapped shared so deletes show up at once
+    std::atomic<uint64_t> tombstonesVersion{0};  // Version the result cache was last cleared for
     int totalDocs;
     double avgDocLength;
+    Traversal traversal = TRAVERSAL_AUTO;
+    QueryBudget budget;
+    TierMode tierMode = TIER_SAFE;
+    ResultCache resultCache;
+    BlockCache blockCache;
+    std::shared_ptr<ThreadPool> rangePool;  // Helpers for docID-range parallelism; the caller takes a range too
+    size_t rangeCount = 1;
+    int64_t parallelMinPostings = PARALLEL_MIN_POSTINGS;
+    bool reportMissingTerms = true;
 
-    std::vector<std::string> parseQuery(const std::string &query);
-    void loadPageTable(const std::string &pageTableFilename);
-    void loadDocumentLengths(const std::string &docLengthsFilename);
+    size_t evaluate(const uint32_t *termIndices, size_t termCount, bool conjunctive, size_t k, SearchResult *results,
+                    const float *termIDFs = nullptr);
+    InvertedListPointer *openCursors(const uint32_t *termIndices, size_t termCount, const float *termIDFs) const;
+    void conjunctiveDAAT(InvertedListPointer *cursors, size_t cursorCount, TopK &topK);
+    void disjunctiveDAAT(InvertedListPointer *cursors, size_t cursorCount, TopK &topK);
+    void disjunctiveTAAT(InvertedListPointer *cursors, size_t cursorCount, TopK &topK);
+    bool preferTAAT(const InvertedListPointer *cursors, size_t cursorCount) const;
+    size_t disjunctiveParallel(const uint32_t *termIndices, size_t termCount, const float *termIDFs, const InvertedListPointer *cursors, double seed, size_t k, SearchResult *results);
+    void disjunctiveRange(const uint32_t *termIndices, size_t termCount, const float *termIDFs, int firstDocID, int endDocID, TopK &topK, std::atomic<double> &sharedThreshold);
+    void scoreAtATime(const uint32_t *termIndices, size_t termCount, TopK &topK);
+    void seedThreshold(const uint32_t *termIndices, size_t termCount, size_t k, TopK &topK) const;
+    bool searchTier1(const uint32_t *termIndices, size_t termCount, size_t k, SearchResult *results, size_t &resultCount);
 };
 
 #endif // QUERY_PROCESSOR_H
@@ -0,0 +1,126 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
+// Bounded lock-free multi-producer multi-consumer queue (Vyukov's ring): each cell carries
+// a sequence number telling producers and consumers whose turn it is, so a push or pop is
+// one CAS on the shared position plus a store to the cell. The blocking push/pop back off
+// from spinning to yielding to short sleeps; a full ring holds producers back, which is
+// the backpressure between pipeline stages.
+template <typename T>
+class MpmcRing {
+public:
+    explicit MpmcRing(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    MpmcRing(const MpmcRing &) = delete;
+    MpmcRing &operator=(const MpmcRing &) = delete;
+
+    bool tryPush(T &value) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = cells[pos & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // Full
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T &value) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = cells[pos & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // Empty
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Wait for room; returns the time spent waiting, in seconds
+    double push(T &value) {
+        if (tryPush(value)) return 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int attempt = 0; !tryPush(value); ++attempt) backOff(attempt);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Wait for a value; false once the ring is closed and drained. waited gets the time spent waiting.
+    bool pop(T &value, double &waited) {
+        waited = 0;
+        if (tryPop(value)) return true;
+        auto start = std::chrono::steady_clock::now();
+        for (int attempt = 0;; ++attempt) {
+            if (tryPop(value)) break;
+            if (closedFlag.load(std::memory_order_acquire)) {
+                // Producers are done; take anything pushed before the close
+                if (!tryPop(value)) {
+                    waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    return false;
+                }
+                break;
+            }
+            backOff(attempt);
+        }
+        waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+
+    // No more pushes will come
+    void close() { closedFlag.store(true, std::memory_order_release); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static void backOff(int attempt) {
+        if (attempt < 64) {
+            // Spin briefly: the other side is usually just about to move
+        } else if (attempt < 256) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) std::atomic<size_t> dequeuePos{0};
+    alignas(64) std::atomic<bool> closedFlag{false};
+};
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,46 @@
+#ifndef SCORE_ACCUMULATOR_H
+#define SCORE_ACCUMULATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "top_k.h"
+
+// Docs per accumulator page; pages are cleared lazily the first time a query touches them
+const int ACCUMULATOR_PAGE_BITS = 10;
+const int ACCUMULATOR_PAGE_SIZE = 1 << ACCUMULATOR_PAGE_BITS;
+
+// Dense docID-indexed score accumulator for term-at-a-time scoring. Each page carries the
+// number of the query that last cleared it, so starting a query costs nothing and only the
+// pages a query touches are ever cleared or scanned. A touched bit per document tells
+// real zero (or negative) scores from untouched slots.
+class ScoreAccumulator {
+public:
+    // Start a query over docIDs [0, docCount). Storage only grows, so after the first
+    // query this does not allocate.
+    void begin(size_t docCount);
+
+    void add(int docID, double score) {
+        size_t page = static_cast<size_t>(docID) >> ACCUMULATOR_PAGE_BITS;
+        if (pageQuery[page] != query) clearPage(page);
+        scores[docID] += score;
+        touched[docID >> 6] |= uint64_t(1) << (docID & 63);
+    }
+
+    // Push every touched document that beats the top-k threshold into topK, scanning
+    // scores against the threshold a vector at a time
+    void collect(TopK &topK) const;
+
+    // Accumulator of the calling thread
+    static ScoreAccumulator &local();
+
+private:
+    void clearPage(size_t page);
+
+    std::vector<double> scores;
+    std::vector<uint64_t> touched;
+    std::vector<uint32_t> pageQuery;
+    uint32_t query = 0;
+};
+
+#endif // SCORE_ACCUMULATOR_H
@@ -0,0 +1,53 @@
+#ifndef SEGMENT_MANIFEST_H
+#define SEGMENT_MANIFEST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A segment is a directory holding a complete, immutable index over its own local docIDs
+// 0..docCount-1: index.bin, lexicon.bin (with the files built next to them), page_table.bin
+// and doc_lengths.bin. The batch build in ../data is the first segment; new documents are
+// indexed into new segments, and merges replace adjacent segments by one.
+//
+// The manifest lists the live segments in docID order, as text:
+//   generation <n>
+//   segment <directory> <docBase> <docCount>
+// A segment's documents have global docIDs docBase + local docID. The manifest is replaced
+// by rename, so readers see either the old or the new segment set.
+const char *const SEGMENT_MANIFEST_FILENAME = "../data/manifest.txt";
+const char *const SEGMENT_BASE_DIRECTORY = "../data";
+const char *const SEGMENT_ROOT_DIRECTORY = "../data/segments";
+
+// Tiered merging: SEGMENT_MERGE_FACTOR adjacent segments of one tier become one segment of
+// the next tier. Tier t holds segments of up to SEGMENT_TIER_FLOOR_DOCS * factor^t documents.
+const size_t SEGMENT_MERGE_FACTOR = 4;
+const int64_t SEGMENT_TIER_FLOOR_DOCS = 10000;
+
+struct SegmentInfo {
+    std::string directory;
+    int64_t docBase = 0;
+    int64_t docCount = 0;
+};
+
+struct SegmentManifest {
+    int64_t generation = 0;  // Same type as the query processor's generation numbers, where -1 means no manifest
+    std::vector<SegmentInfo> segments;
+
+    // First docID after the last segment
+    int64_t docEnd() const { return segments.empty() ? 0 : segments.back().docBase + segments.back().docCount; }
+};
+
+// Path of a segment file, e.g. segmentFile(dir, "index.bin")
+std::string segmentFile(const std::string &directory, const std::string &name);
+
+bool readManifest(const std::string &filename, SegmentManifest &manifest);
+// Write to a temporary file and rename it over the manifest
+bool writeManifest(const std::string &filename, const SegmentManifest &manifest);
+
+int segmentTier(int64_t docCount);
+// Adjacent segments [first, last) the tiered policy would merge next; false when none
+bool findTieredMerge(const SegmentManifest &manifest, size_t &first, size_t &last);
+
+#endif // SEGMENT_MANIFEST_H
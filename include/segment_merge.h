@@ -0,0 +1,36 @@
+#ifndef SEGMENT_MERGE_H
+#define SEGMENT_MERGE_H
+
+#include <string>
+#include <vector>
+#include "segment_manifest.h"
+#include "tombstones.h"
+
+// Segment maintenance for the merger: appending freshly built segments to the manifest and
+// merging segments. Merges only read the segments they replace and write a new directory;
+// the switch is a rename of the manifest, so query processors keep serving from the
+// segments they have mapped (removed files stay readable until unmapped).
+
+// Segments with at least this percentage of deleted documents are rewritten by compaction
+// even when the tiered policy leaves them alone
+const int SEGMENT_EXPUNGE_PERCENT = 20;
+
+// Add the segment built in directory at the end of the manifest. Without a manifest, one is
+// started with the batch index in SEGMENT_BASE_DIRECTORY as the first segment.
+bool appendSegment(const std::string &directory);
+
+// Make the index built in directory (a full rebuild into a fresh directory) the only segment
+// in the manifest, and remove the segments it replaces. Running query processors swap it in
+// on their next reload.
+bool publishSegment(const std::string &directory);
+
+// Merge adjacent segments, in docID order, into one segment written to outputDirectory,
+// dropping the postings of deleted documents. On success the inputs' tombstones are left
+// locked in locks, for the caller to release once the manifest lists the merged segment.
+bool mergeSegments(const std::vector<SegmentInfo> &inputs, const std::string &outputDirectory, TombstonesLocks &locks);
+
+// Apply the tiered merge policy, and rewrite segments with many deletions, until there is
+// nothing left to do. Returns the number of merges done, or -1 on error.
+int compactSegments();
+
+#endif // SEGMENT_MERGE_H
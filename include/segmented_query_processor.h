@@ -0,0 +1,130 @@
+#ifndef SEGMENTED_QUERY_PROCESSOR_H
+#define SEGMENTED_QUERY_PROCESSOR_H
+
+#include "query_processor.h"
+#include "index_warmup.h"
+#include "segment_manifest.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// How often the reload thread looks at the manifest
+const int RELOAD_POLL_MILLISECONDS = 1000;
+// Most recent queries replayed against a new generation before it goes live
+const size_t RELOAD_WARMUP_QUERIES = 64;
+
+// Query processor over the segments in the manifest. Every segment is searched by its own
+// QueryProcessor with each term weighed by its IDF over all segments, and the per-segment
+// top-k lists are merged under global docIDs (segment docBase + local docID), so the
+// results are those of one index over all the documents. Without a manifest the batch
+// index in SEGMENT_BASE_DIRECTORY is the only segment and queries go to it unchanged.
+//
+// The segments open at one time form a generation. reload() opens the segments of a newer
+// manifest, warms them (the warmup terms, then the latest queries) and swaps them in with
+// an atomic store.
+// Queries keep a reference to the generation they started on and finish there; the old
+// generation is closed, and its files unmapped, once the last of them is done.
+//
+// Queries over several segments bypass the segments' own result caches (see searchTerms),
+// so their results are cached in the generation, sized before it goes live, under the sum
+// of the segments' tombstone versions; a delete in any segment makes the older entries misses.
+//
+// Champion lists, the tier-1 index and the impact index hold scores computed with a
+// segment's own IDFs, so a generation of several segments goes without them: no champion
+// shortcut or threshold seed, and OR queries run DAAT or TAAT even with TRAVERSAL_SAAT or
+// TIER_APPROXIMATE set (the first such query warns). Only the batch index alone uses them.
+class SegmentedQueryProcessor {
+public:
+    explicit SegmentedQueryProcessor(const std::string &manifestFilename = SEGMENT_MANIFEST_FILENAME);
+    ~SegmentedQueryProcessor();
+
+    // Run a query and print the top 10 results
+    void processQuery(const std::string &query, bool conjunctive);
+    size_t search(std::string_view query, bool conjunctive, size_t k, SearchResult *results);
+
+    // Settings apply to every segment, now and in later generations; cache sizes are shared
+    // out between the segments, and so is one pool of threads - 1 workers for parallel
+    // ranges. Set them before serving queries.
+    void setTraversal(Traversal mode);
+    void setBudget(const QueryBudget &limits);
+    void setTierMode(TierMode mode);
+    void setCacheSizes(size_t resultBytes, size_t blockBytes);
+    void setParallelism(size_t threads, int64_t minPostings = PARALLEL_MIN_POSTINGS);
+    bool hasImpactIndex() const;
+    CacheStats resultCacheStats();
+    CacheStats blockCacheStats();
+    size_t segmentCount() const;
+
+    // Posting lists of these terms, most frequent first, are read into memory for every
+    // generation before it serves, within the budget
+    void setWarmup(std::vector<std::string> terms, const WarmupBudget &budget);
+    // Warm the live generation up; at startup, before serving queries
+    WarmupStats warmUp();
+
+    // Swap in the manifest's segments if its generation changed. Returns true if a new
+    // generation went live; on failure the current one keeps serving.
+    bool reload();
+    // Run reload every pollMilliseconds on a background thread
+    void startReloading(int pollMilliseconds = RELOAD_POLL_MILLISECONDS);
+
+private:
+    struct Segment {
+        int64_t docBase;
+        std::unique_ptr<QueryProcessor> processor;
+    };
+
+    struct Generation {
+        int64_t number = -1;  // Manifest generation; -1 for the batch index without a manifest
+        std::vector<Segment> segments;
+        bool warming = false;  // Being warmed up by reload, before it goes live
+        SegmentResultCache resultCache;  // Used when there is more than one segment
+
+        const Segment &segmentOf(int docID) const;
+    };
+
+    struct Settings {
+        Traversal traversal = TRAVERSAL_AUTO;
+        QueryBudget budget;
+        TierMode tierMode = TIER_SAFE;
+        size_t resultCacheBytes = RESULT_CACHE_BYTES;
+        size_t blockCacheBytes = BLOCK_CACHE_BYTES;
+        size_t threads = 1;
+        int64_t parallelMinPostings = PARALLEL_MIN_POSTINGS;
+    };
+
+    std::shared_ptr<Generation> openGeneration(int64_t number, const std::vector<SegmentInfo> &segments, std::ostream &messages) const;
+    void applySettings(Generation &generation) const;
+    void warnIgnoredSettings(const Generation &generation);
+    std::shared_ptr<Generation> current() const { return std::atomic_load(&live); }
+    size_t search(Generation &generation, std::string_view query, bool conjunctive, size_t k, SearchResult *results);
+    void rememberQuery(std::string_view query, bool conjunctive);
+    WarmupStats warmUp(const Generation &generation) const;
+
+    std::string manifestFilename;
+    std::shared_ptr<Generation> live;  // Read and replaced with the atomic shared_ptr functions
+    Settings settings;
+    std::shared_ptr<ThreadPool> rangePool;  // Given to every segment while settings.threads > 1
+    std::mutex reloadMutex;            // One reload (or settings change) at a time
+    int64_t failedGeneration = -2;     // Last manifest generation that could not be opened
+    std::atomic<bool> warnedIgnoredSettings{false};
+    std::vector<std::string> warmupTerms;
+    WarmupBudget warmupBudget;
+
+    // Latest queries, for warming up a new generation
+    std::mutex recentMutex;
+    std::vector<std::pair<std::string, bool>> recentQueries;
+    size_t nextRecent = 0;
+
+    std::thread reloader;
+    std::mutex reloaderMutex;
+    std::condition_variable reloaderWake;
+    bool stopping = false;
+};
+
+#endif // SEGMENTED_QUERY_PROCESSOR_H
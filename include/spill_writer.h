@@ -0,0 +1,58 @@
+#ifndef SPILL_WRITER_H
+#define SPILL_WRITER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "utils.h"
+
+// Packed sort key for one term-docID pair: (term rank << 32) | docID
+struct SpillRecord {
+    uint64_t key;
+    float termFScore;
+};
+
+// Parallel LSD radix sort on packed keys. scratch is resized as needed and reused across calls.
+void parallelRadixSort(std::vector<SpillRecord> &records, std::vector<SpillRecord> &scratch, size_t threads);
+
+// Dedicated sorter/writer stage for temp files. A worker hands over its full buffer and
+// gets the other (already written) buffer back, so parsing continues while the previous
+// run is sorted and written in the background (double buffering).
+class SpillWriter {
+public:
+    // Runs are written to runDirectory/temp<fileCounter>.bin
+    explicit SpillWriter(size_t sortThreads = 4, const std::string &runDirectory = "../data/intermediate");
+    ~SpillWriter();
+
+    // Swap a full buffer with the empty one and queue it as temp file fileCounter.
+    // Only waits if the previous spill has not finished yet.
+    void submit(std::vector<TermDocPair> &buffer, int fileCounter);
+    // Wait for the queued spill to be written and stop the spill thread.
+    void finish();
+
+private:
+    void run();
+    void spill(const std::vector<TermDocPair> &termDocPairs, int fileCounter);
+
+    size_t sortThreads;
+    std::string runDirectory;
+    std::thread spillThread;
+    std::mutex spillMutex;
+    std::condition_variable spillQueued;
+    std::condition_variable spillDone;
+
+    std::vector<TermDocPair> pending; // Buffer being spilled, handed back empty afterwards
+    int pendingFileCounter;
+    bool hasPending;
+    bool stop;
+
+    // Reused between spills to avoid reallocating
+    std::vector<SpillRecord> records;
+    std::vector<SpillRecord> scratch;
+};
+
+#endif // SPILL_WRITER_H
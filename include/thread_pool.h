@@ -5,36 +5,102 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
+#include <deque>
 #include <functional>
+#include <future>
+#include <memory>
 #include <vector>
 #include <atomic>
 
+class ThreadPool;
+
+// Handle on a set of tasks, so a caller waits for its own work only
+class TaskGroup {
+public:
+    TaskGroup() = default;
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    // Wait until every task submitted to this group has run. The waiting thread runs
+    // the group's queued tasks itself in the meantime.
+    void wait();
+
+private:
+    friend class ThreadPool;
+    void finishTask();
+
+    std::atomic<ThreadPool *> pool{nullptr};
+    std::atomic<size_t> pending{0};
+    std::mutex doneMutex;
+    std::condition_variable done;
+};
+
+// Work-stealing pool: every worker owns a deque. Workers pop their own newest task and
+// steal the oldest task of another worker when theirs is empty, so tasks only contend on
+// a deque's lock when it is being stolen from. Tasks submitted from a worker go to its own
+// deque; others are spread round robin.
 class ThreadPool {
 public:
+    // maxThreadsInQueue bounds the queued tasks for submit and enqueue: a caller that
+    // finds the pool that full runs queued tasks itself until there is room
     explicit ThreadPool(size_t threads = 8, size_t maxThreadsInQueue = 32);
     ~ThreadPool();
 
+    void submit(TaskGroup &group, std::function<void()> f);
+    // Queue many tasks at once, one lock per worker deque; not bounded by maxThreadsInQueue
+    void submitBatch(TaskGroup &group, std::vector<std::function<void()>> &tasks);
+
+    // Run f on the pool and get its result through a future
+    template <typename F>
+    auto submit(F &&f) -> std::future<decltype(f())> {
+        auto task = std::make_shared<std::packaged_task<decltype(f())()>>(std::forward<F>(f));
+        std::future<decltype(f())> result = task->get_future();
+        submit(ungrouped, [task] { (*task)(); });
+        return result;
+    }
+
+    // Submit to, and wait for, the pool's own group
     void enqueue(std::function<void()> f);
     void waitAll();
 
+    size_t size() const { return workers.size(); }
+
 private:
-    void worker();
+    friend class TaskGroup;
+
+    struct Task {
+        std::function<void()> run;
+        TaskGroup *group;
+    };
+
+    struct WorkQueue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    void worker(size_t index);
+    void push(size_t queue, Task task);
+    bool popTask(size_t index, Task &task, const TaskGroup *group = nullptr);
+    bool runPendingTask(const TaskGroup *group = nullptr);
+    void execute(Task &task);
+    void wakeWorkers(size_t count);
+    size_t targetQueue();
 
-    // Thread pool state
     std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
 
-    // Synchronization primitives
-    std::mutex queueMutex;
+    // Idle workers sleep here until something is queued
+    std::mutex sleepMutex;
     std::condition_variable taskAvailable;
-    std::condition_variable spaceAvailable;
-    std::condition_variable allTasksDone;  // Condition variable to signal when all tasks are done
+    std::atomic<size_t> sleeping{0};
 
-    // Control variables
-    bool stop;
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> queued{0};   // Tasks sitting in the deques
+    std::atomic<size_t> nextQueue{0};
     size_t maxThreadsInQueue;
-    std::atomic<size_t> tasksRemaining;  // Counter for tasks remaining to be processed
+
+    TaskGroup defaultGroup;  // enqueue / waitAll
+    TaskGroup ungrouped;     // Tasks behind futures; never waited on
 };
 
 #endif // THREADPOOL_H
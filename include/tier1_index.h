@@ -0,0 +1,55 @@
+#ifndef TIER1_INDEX_H
+#define TIER1_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "inverted_index.h"
+
+// Statically pruned first-tier index: for every term, only its TIER1 postings with the
+// highest scores (IDF * term frequency score), block-encoded in docID order. Records are
+// in lexicon term order and keep the full list's IDF; docFrequency is the number of
+// postings kept. residual[t] bounds the score of any posting of t left out of the tier
+// (0 when the whole list fits), which lets the query processor prove when tier-1
+// results are exact.
+//   lists
+//   LexiconRecord records[termCount]   (8-byte aligned)
+//   float residual[termCount]
+//   Tier1Footer at the very end
+const uint32_t TIER1_MAGIC = 0x31524954; // "TIR1"
+
+struct Tier1Footer {
+    uint32_t magic;
+    uint32_t termCount;
+    uint64_t recordOffset;
+    uint64_t residualOffset;
+    uint32_t postingsPerTerm;
+    uint32_t reserved;
+};
+
+// The tier-1 index lives next to the full one ("index.bin" -> "tier1_index.bin")
+std::string tier1IndexFilename(const std::string &indexFilename);
+
+// Build the tier-1 index from a finished index and its lexicon
+bool buildTier1Index(const std::string &indexFilename, const std::string &lexiconFilename,
+                     const std::string &outputFilename, uint32_t postingsPerTerm);
+
+// Tier-1 index loaded whole into memory
+class Tier1Index {
+public:
+    bool open(const std::string &filename);
+    bool isOpen() const { return !data.empty(); }
+    uint32_t termCount() const { return footer.termCount; }
+    size_t sizeBytes() const { return data.size(); }
+    float residual(uint32_t termIndex) const { return residuals[termIndex]; }
+    // Open a cursor over a term's pruned list; docBuffer must hold MAX_BLOCK_POSTINGS ints
+    InvertedListPointer openList(uint32_t termIndex, int *docBuffer) const;
+
+private:
+    std::vector<unsigned char> data;
+    Tier1Footer footer = {};
+    const LexiconRecord *records = nullptr;
+    const float *residuals = nullptr;
+};
+
+#endif // TIER1_INDEX_H
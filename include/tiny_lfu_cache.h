@@ -0,0 +1,239 @@
+#ifndef TINY_LFU_CACHE_H
+#define TINY_LFU_CACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+const size_t CACHE_SHARDS = 16;
+const int CACHE_SKETCH_ROWS = 4;
+const uint8_t CACHE_SKETCH_MAX = 15;
+
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t admitted = 0;
+    uint64_t rejected = 0;  // Turned away by the admission filter
+
+    double hitRate() const { return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0.0; }
+};
+
+// Byte-bounded cache of fixed-size entries, split into independently locked shards.
+// Eviction is LRU, but a new key only replaces the LRU victim if a count-min sketch of
+// recent accesses (TinyLFU) says it is asked for more often, so one-off keys from a scan
+// cannot flush the entries that keep being hit. All memory is allocated by resize();
+// lookups and inserts never touch the heap.
+//
+// Key must be trivially copyable, compare with ==, and provide uint64_t hash().
+// Values are read and written in place under the shard lock through callbacks.
+template <typename Key, typename Value>
+class TinyLfuCache {
+    static_assert(std::is_trivially_copyable<Key>::value, "Cache keys are copied into fixed slots");
+
+public:
+    // Room for as many entries as fit in bytes; 0 disables the cache
+    void resize(size_t bytes) {
+        size_t perShard = bytes / CACHE_SHARDS / entryBytes();
+        enabledFlag.store(perShard > 0, std::memory_order_relaxed);
+        for (Shard &shard : shards) {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            shard.resize(perShard);
+        }
+    }
+    bool enabled() const { return enabledFlag.load(std::memory_order_relaxed); }
+
+    // Call reader(const Value &) and return true if key is cached
+    template <typename Reader>
+    bool lookup(const Key &key, Reader &&reader) {
+        uint64_t hash = key.hash();
+        Shard &shard = shardOf(hash);
+        std::lock_guard<std::mutex> guard(shard.lock);
+        shard.recordAccess(hash);
+        int32_t slot = shard.find(hash, key);
+        if (slot < 0) {
+            shard.stats.misses++;
+            return false;
+        }
+        shard.stats.hits++;
+        shard.moveToFront(slot);
+        reader(static_cast<const Value &>(shard.entries[slot].value));
+        return true;
+    }
+
+    // Store a value written by writer(Value &), unless the admission filter rejects the key
+    template <typename Writer>
+    bool insert(const Key &key, Writer &&writer) {
+        uint64_t hash = key.hash();
+        Shard &shard = shardOf(hash);
+        std::lock_guard<std::mutex> guard(shard.lock);
+        if (shard.capacity == 0) return false;
+        int32_t slot = shard.find(hash, key);
+        if (slot < 0) {
+            slot = shard.allocate(hash);
+            if (slot < 0) {
+                shard.stats.rejected++;
+                return false;
+            }
+            shard.entries[slot].key = key;
+            shard.entries[slot].hash = hash;
+            shard.link(slot);
+            shard.stats.admitted++;
+        } else {
+            shard.moveToFront(slot);
+        }
+        writer(shard.entries[slot].value);
+        return true;
+    }
+
+    // Drop every entry (the counters are kept)
+    void clear() {
+        for (Shard &shard : shards) {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            shard.resize(shard.capacity);
+        }
+    }
+
+    CacheStats stats() {
+        CacheStats total;
+        for (Shard &shard : shards) {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            total.hits += shard.stats.hits;
+            total.misses += shard.stats.misses;
+            total.admitted += shard.stats.admitted;
+            total.rejected += shard.stats.rejected;
+        }
+        return total;
+    }
+
+private:
+    struct Entry {
+        Key key;
+        Value value;
+        uint64_t hash;
+        int32_t prev, next;  // Recency list, most recent at head
+    };
+
+    struct Shard {
+        std::mutex lock;
+        std::vector<Entry> entries;
+        std::vector<int32_t> table;    // Open addressing over entry indices, -1 when empty
+        std::vector<uint8_t> sketch;   // CACHE_SKETCH_ROWS rows of saturating counters
+        size_t capacity = 0, used = 0, tableMask = 0, sketchMask = 0, additions = 0;
+        int32_t head = -1, tail = -1;
+        CacheStats stats;
+
+        void resize(size_t entryCount) {
+            capacity = entryCount;
+            used = 0;
+            head = tail = -1;
+            additions = 0;
+            entries.assign(entryCount, Entry());
+            size_t tableSize = 1, sketchWidth = 64;
+            while (tableSize < entryCount * 2) tableSize <<= 1;
+            while (sketchWidth < entryCount) sketchWidth <<= 1;
+            table.assign(entryCount ? tableSize : 0, -1);
+            tableMask = tableSize - 1;
+            sketch.assign(entryCount ? sketchWidth * CACHE_SKETCH_ROWS : 0, 0);
+            sketchMask = sketchWidth - 1;
+        }
+
+        size_t sketchIndex(uint64_t hash, int row) const {
+            uint64_t h = (hash + row) * 0x9E3779B97F4A7C15ULL;
+            return row * (sketchMask + 1) + ((h >> 32) & sketchMask);
+        }
+
+        void recordAccess(uint64_t hash) {
+            if (capacity == 0) return;
+            for (int row = 0; row < CACHE_SKETCH_ROWS; ++row) {
+                uint8_t &counter = sketch[sketchIndex(hash, row)];
+                if (counter < CACHE_SKETCH_MAX) counter++;
+            }
+            // Age the counts so the sketch follows shifts in popularity
+            if (++additions >= capacity * 10) {
+                for (uint8_t &counter : sketch) counter >>= 1;
+                additions /= 2;
+            }
+        }
+
+        uint8_t frequency(uint64_t hash) const {
+            uint8_t estimate = CACHE_SKETCH_MAX;
+            for (int row = 0; row < CACHE_SKETCH_ROWS; ++row) {
+                estimate = std::min(estimate, sketch[sketchIndex(hash, row)]);
+            }
+            return estimate;
+        }
+
+        int32_t find(uint64_t hash, const Key &key) const {
+            if (capacity == 0) return -1;
+            for (size_t i = hash & tableMask; table[i] >= 0; i = (i + 1) & tableMask) {
+                const Entry &entry = entries[table[i]];
+                if (entry.hash == hash && entry.key == key) return table[i];
+            }
+            return -1;
+        }
+
+        // Free slot for a new key: an unused one, or the LRU entry if the key is more popular
+        int32_t allocate(uint64_t hash) {
+            if (used < capacity) return static_cast<int32_t>(used++);
+            int32_t victim = tail;
+            if (frequency(hash) <= frequency(entries[victim].hash)) return -1;
+            unlink(victim);
+            erase(entries[victim].hash, victim);
+            return victim;
+        }
+
+        // Add slot to the table and the front of the recency list
+        void link(int32_t slot) {
+            size_t i = entries[slot].hash & tableMask;
+            while (table[i] >= 0) i = (i + 1) & tableMask;
+            table[i] = slot;
+            entries[slot].prev = -1;
+            entries[slot].next = head;
+            if (head >= 0) entries[head].prev = slot;
+            head = slot;
+            if (tail < 0) tail = slot;
+        }
+
+        void unlink(int32_t slot) {
+            Entry &entry = entries[slot];
+            if (entry.prev >= 0) entries[entry.prev].next = entry.next; else head = entry.next;
+            if (entry.next >= 0) entries[entry.next].prev = entry.prev; else tail = entry.prev;
+        }
+
+        void moveToFront(int32_t slot) {
+            if (head == slot) return;
+            unlink(slot);
+            entries[slot].prev = -1;
+            entries[slot].next = head;
+            entries[head].prev = slot;
+            head = slot;
+        }
+
+        // Remove slot from the table, shifting later probes back so lookups stay correct
+        void erase(uint64_t hash, int32_t slot) {
+            size_t i = hash & tableMask;
+            while (table[i] != slot) i = (i + 1) & tableMask;
+            for (size_t j = (i + 1) & tableMask; table[j] >= 0; j = (j + 1) & tableMask) {
+                size_t home = entries[table[j]].hash & tableMask;
+                bool movable = i <= j ? (home <= i || home > j) : (home <= i && home > j);
+                if (movable) {
+                    table[i] = table[j];
+                    i = j;
+                }
+            }
+            table[i] = -1;
+        }
+    };
+
+    static size_t entryBytes() { return sizeof(Entry) + 2 * sizeof(int32_t) + CACHE_SKETCH_ROWS; }
+    Shard &shardOf(uint64_t hash) { return shards[(hash >> 40) % CACHE_SHARDS]; }
+
+    Shard shards[CACHE_SHARDS];
+    std::atomic<bool> enabledFlag{false};  // Read by queries without the shard locks
+};
+
+#endif // TINY_LFU_CACHE_H
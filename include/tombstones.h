@@ -0,0 +1,89 @@
+#ifndef TOMBSTONES_H
+#define TOMBSTONES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+
+// Deleted documents of a segment, a bitmap over its docIDs kept next to its index:
+//   TombstonesHeader
+//   words      uint64[(docCount + 63) / 64], bit d set if docID d is deleted
+// Deleting only sets bits in place, so query processors that have the file mapped stop
+// returning a document as soon as it is deleted. Its postings stay in the index until the
+// next merge of the segment drops them.
+const uint32_t TOMBSTONES_MAGIC = 0x424D4F54; // "TOMB"
+
+struct TombstonesHeader {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t docCount;
+    uint64_t deletedCount;  // Deleted documents whose postings are still in the index
+    uint64_t version;       // Bumped by every delete that marks a new document
+};
+
+// Tombstones live next to the index ("index.bin" -> "tombstones.bin")
+std::string tombstonesFilename(const std::string &indexFilename);
+
+// Write the tombstones of a segment with docCount documents: the deleted bitmap words, or
+// none deleted if words is nullptr. Replaces an existing file.
+bool writeTombstones(const std::string &filename, uint64_t docCount, const uint64_t *words = nullptr);
+
+// Returned by deleteDocuments when the segment was merged away before the lock was had
+const int64_t TOMBSTONES_MOVED = -2;
+
+// Mark documents deleted in a tombstones file, in place. Concurrent deletes are serialized
+// with a lock on the file. If stillListed is given it is called once the lock is held (or
+// the file is found gone), and nothing is marked when it returns false, so the caller can
+// resolve the docIDs again against the segments that replaced this one. Returns the number
+// of documents newly deleted, TOMBSTONES_MOVED, or -1 on error.
+int64_t deleteDocuments(const std::string &filename, const int *docIDs, size_t count,
+                        const std::function<bool()> &stillListed = nullptr);
+
+// Exclusive locks on tombstones files, the ones deleteDocuments takes: while they are held
+// no delete lands in the files. A merge holds them from reading the inputs' last deletes
+// until the manifest no longer lists the inputs.
+class TombstonesLocks {
+public:
+    TombstonesLocks() = default;
+    TombstonesLocks(const TombstonesLocks &) = delete;
+    TombstonesLocks &operator=(const TombstonesLocks &) = delete;
+    ~TombstonesLocks() { unlock(); }
+
+    // Blocks until running deletes on the file are done
+    bool lock(const std::string &filename);
+    void unlock();
+
+private:
+    std::vector<int> fds;
+};
+
+// Read-only view of a segment's tombstones, used directly from the shared mapping
+class Tombstones {
+public:
+    bool open(const std::string &filename);
+    void close() {
+        file.close();
+        header = nullptr;
+        words = nullptr;
+    }
+    bool isOpen() const { return header != nullptr; }
+    uint64_t docCount() const { return header ? header->docCount : 0; }
+    // Both may change under a running query processor, as delete_docs writes the file
+    uint64_t deletedCount() const { return header ? __atomic_load_n(&header->deletedCount, __ATOMIC_ACQUIRE) : 0; }
+    uint64_t version() const { return header ? __atomic_load_n(&header->version, __ATOMIC_ACQUIRE) : 0; }
+    // The bitmap, or nullptr while nothing is deleted so callers can skip the checks
+    const uint64_t *deletedBitmap() const { return deletedCount() ? words : nullptr; }
+    bool isDeleted(int docID) const {
+        return words && (words[docID >> 6] >> (docID & 63) & 1);
+    }
+
+private:
+    MappedFile file;
+    const TombstonesHeader *header = nullptr;
+    const uint64_t *words = nullptr;
+};
+
+#endif // TOMBSTONES_H
@@ -0,0 +1,69 @@
+#ifndef TOP_K_H
+#define TOP_K_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+struct SearchResult {
+    int docID;
+    double score;
+};
+
+// Fixed-capacity top-k collector over caller-provided storage (a min-heap on score)
+class TopK {
+public:
+    TopK(SearchResult *storage, size_t capacity) : heap(storage), capacity(capacity), count(0) {}
+
+    // Returns true if the document entered the top-k
+    bool push(int docID, double score) {
+        if (capacity == 0 || score <= floor) return false;
+        // Only documents good enough to get in are looked up in the exclusion bitmap
+        if (count < capacity) {
+            if (isExcluded(docID)) return false;
+            heap[count++] = SearchResult{docID, score};
+            std::push_heap(heap, heap + count, greaterScore);
+            return true;
+        }
+        if (score <= heap[0].score || isExcluded(docID)) return false;
+        std::pop_heap(heap, heap + count, greaterScore);
+        heap[count - 1] = SearchResult{docID, score};
+        std::push_heap(heap, heap + count, greaterScore);
+        return true;
+    }
+
+    // Lower bound on the final k-th score known before scoring: documents below it are turned away
+    // even while the top-k is filling. Documents scoring exactly the bound still get in.
+    void raiseFloor(double score) { floor = std::max(floor, std::nextafter(score, -HUGE_VAL)); }
+
+    // Turn away the documents whose bits are set in excluded (deleted ones); nullptr for none
+    void exclude(const uint64_t *excluded) { excludedBits = excluded; }
+    // Excluded documents among the 64 starting at docID group * 64
+    uint64_t excludedWord(size_t group) const { return excludedBits ? excludedBits[group] : 0; }
+
+    bool full() const { return count == capacity; }
+    // Score a document has to beat to enter the top-k
+    double threshold() const { return full() && count > 0 ? heap[0].score : floor; }
+    size_t size() const { return count; }
+
+    // Sort the results by descending score in place and return their number
+    size_t finish() {
+        std::sort_heap(heap, heap + count, greaterScore);
+        return count;
+    }
+
+private:
+    bool isExcluded(int docID) const {
+        return excludedBits && (excludedBits[docID >> 6] >> (docID & 63) & 1);
+    }
+    static bool greaterScore(const SearchResult &a, const SearchResult &b) { return a.score > b.score; }
+
+    SearchResult *heap;
+    size_t capacity;
+    size_t count;
+    double floor = -1e300;
+    const uint64_t *excludedBits = nullptr;
+};
+
+#endif // TOP_K_H
@@ -37,9 +37,11 @@ struct TermDocPair {
 // Helper function to create directories for data 
 void createDirectory(const std::string &dir);
 std::vector<std::string> tokenize(const std::string &text);
-void saveTermDocPairsToFile(const std::vector<TermDocPair> &termDocPairs, const int &fileCounter);
-void writePageTableToFile(const std::unordered_map<int, std::string> &pageTable);
-void writeDocLengthsToFile(const std::unordered_map<int, int> &docLengths);
+// Both return false if the file could not be written
+bool writePageTableToFile(const std::unordered_map<int, std::string> &pageTable,
+                          const std::string &filename = "../data/page_table.bin");
+bool writeDocLengthsToFile(const std::unordered_map<int, int> &docLengths,
+                           const std::string &filename = "../data/doc_lengths.bin");
 
 
 #endif
\ No newline at end of file
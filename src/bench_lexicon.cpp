@@ -0,0 +1,81 @@
+// Microbenchmark: term -> lexicon record lookup with the old unordered_map,
+// the front-coded binary search and the minimal perfect hash
+#include "lexicon.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+template <typename Lookup>
+void runBenchmark(const std::string &name, const std::vector<std::string> &queries, int rounds, Lookup lookup) {
+    int64_t checksum = 0;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (const auto &query : queries) {
+            checksum += lookup(query);
+        }
+    }
+    auto endTime = std::chrono::high_resolution_clock::now();
+    double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+    std::cout << name << ": " << ns / (static_cast<double>(queries.size()) * rounds) << " ns/lookup"
+              << " (checksum " << checksum << ")" << std::endl;
+}
+
+int main() {
+    Lexicon lexicon;
+    if (!lexicon.open("../data/lexicon.bin")) {
+        return 1;
+    }
+    if (!lexicon.hasPerfectHash()) {
+        std::cerr << "No perfect hash found next to the lexicon, rebuild the index." << std::endl;
+        return 1;
+    }
+
+    // The map the query processor used to build at startup
+    auto buildStart = std::chrono::high_resolution_clock::now();
+    std::unordered_map<std::string, uint32_t> termMap;
+    std::vector<std::string> terms;
+    terms.reserve(lexicon.size());
+    for (uint32_t i = 0; i < lexicon.size(); ++i) {
+        terms.push_back(lexicon.term(i));
+        termMap[terms.back()] = i;
+    }
+    auto buildEnd = std::chrono::high_resolution_clock::now();
+    std::cout << "Terms: " << terms.size() << ", unordered_map build: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(buildEnd - buildStart).count() << " ms" << std::endl;
+
+    // Check that every term resolves to its own record
+    for (uint32_t i = 0; i < terms.size(); ++i) {
+        if (lexicon.find(terms[i]) != i || lexicon.findSorted(terms[i]) != i) {
+            std::cerr << "Lookup mismatch for term: " << terms[i] << std::endl;
+            return 1;
+        }
+    }
+
+    // Workload: 90% hits in random order, 10% misses
+    std::mt19937 rng(42);
+    std::vector<std::string> queries;
+    size_t queryCount = std::min<size_t>(1000000, terms.size() * 4);
+    std::uniform_int_distribution<size_t> pick(0, terms.size() - 1);
+    for (size_t i = 0; i < queryCount; ++i) {
+        std::string term = terms[pick(rng)];
+        if (i % 10 == 0) term += "#";
+        queries.push_back(term);
+    }
+
+    int rounds = 5;
+    runBenchmark("unordered_map", queries, rounds, [&termMap](const std::string &q) -> int64_t {
+        auto it = termMap.find(q);
+        return it == termMap.end() ? -1 : static_cast<int64_t>(it->second);
+    });
+    runBenchmark("front-coded binary search", queries, rounds, [&lexicon](const std::string &q) {
+        return lexicon.findSorted(q);
+    });
+    runBenchmark("minimal perfect hash", queries, rounds, [&lexicon](const std::string &q) {
+        return lexicon.find(q);
+    });
+    return 0;
+}
@@ -0,0 +1,168 @@
+// Contention benchmark: the work-stealing ThreadPool against the single-queue pool it
+// replaced (kept here as LegacyThreadPool), on tiny tasks where scheduling dominates
+#include "thread_pool.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <queue>
+#include <string>
+
+// The previous pool: one queue behind one mutex, global completion counter
+class LegacyThreadPool {
+public:
+    explicit LegacyThreadPool(size_t threads, size_t maxThreadsInQueue)
+        : stop(false), maxThreadsInQueue(maxThreadsInQueue), tasksRemaining(0) {
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([this] { worker(); });
+        }
+    }
+
+    ~LegacyThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            stop = true;
+        }
+        taskAvailable.notify_all();
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+    }
+
+    void enqueue(std::function<void()> f) {
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            while (tasks.size() >= maxThreadsInQueue) {
+                spaceAvailable.wait(lock);
+            }
+            tasks.emplace(std::move(f));
+            ++tasksRemaining;
+        }
+        taskAvailable.notify_one();
+    }
+
+    void waitAll() {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        allTasksDone.wait(lock, [this] { return tasksRemaining == 0; });
+    }
+
+private:
+    void worker() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                taskAvailable.wait(lock, [this] { return stop || !tasks.empty(); });
+                if (stop && tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop();
+                spaceAvailable.notify_one();
+            }
+            task();
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                if (--tasksRemaining == 0) {
+                    allTasksDone.notify_all();
+                }
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable spaceAvailable;
+    std::condition_variable allTasksDone;
+    bool stop;
+    size_t maxThreadsInQueue;
+    std::atomic<size_t> tasksRemaining;
+};
+
+// A task doing about spin iterations of work
+static std::function<void()> makeTask(std::atomic<uint64_t> &sink, int spin) {
+    return [&sink, spin] {
+        uint64_t x = 0;
+        for (int i = 0; i < spin; ++i) x = x * 31 + i;
+        sink += x | 1;
+    };
+}
+
+template <typename Run>
+void runBenchmark(const std::string &name, size_t taskCount, Run run) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+    run();
+    auto endTime = std::chrono::high_resolution_clock::now();
+    double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+    std::cout << name << ": " << ns / taskCount << " ns/task" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    size_t threads = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 8;
+    size_t taskCount = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+    const size_t submitters = 4;
+    std::atomic<uint64_t> sink{0};
+
+    for (int spin : {0, 200}) {
+        std::cout << "Tasks of " << spin << " iterations, " << threads << " workers, " << taskCount << " tasks" << std::endl;
+        {
+            LegacyThreadPool pool(threads, 32);
+            runBenchmark("  legacy, one submitter", taskCount, [&] {
+                for (size_t i = 0; i < taskCount; ++i) pool.enqueue(makeTask(sink, spin));
+                pool.waitAll();
+            });
+            runBenchmark("  legacy, " + std::to_string(submitters) + " submitters", taskCount, [&] {
+                std::vector<std::thread> producers;
+                for (size_t p = 0; p < submitters; ++p) {
+                    producers.emplace_back([&] {
+                        for (size_t i = 0; i < taskCount / submitters; ++i) pool.enqueue(makeTask(sink, spin));
+                    });
+                }
+                for (std::thread &producer : producers) producer.join();
+                pool.waitAll();
+            });
+        }
+        {
+            ThreadPool pool(threads, 32);
+            runBenchmark("  work stealing, one submitter", taskCount, [&] {
+                TaskGroup group;
+                for (size_t i = 0; i < taskCount; ++i) pool.submit(group, makeTask(sink, spin));
+                group.wait();
+            });
+            runBenchmark("  work stealing, " + std::to_string(submitters) + " submitters", taskCount, [&] {
+                std::vector<std::thread> producers;
+                for (size_t p = 0; p < submitters; ++p) {
+                    producers.emplace_back([&] {
+                        TaskGroup group;
+                        for (size_t i = 0; i < taskCount / submitters; ++i) pool.submit(group, makeTask(sink, spin));
+                        group.wait();
+                    });
+                }
+                for (std::thread &producer : producers) producer.join();
+            });
+            runBenchmark("  work stealing, batches of 1024", taskCount, [&] {
+                TaskGroup group;
+                std::vector<std::function<void()>> batch;
+                for (size_t i = 0; i < taskCount; ++i) {
+                    batch.push_back(makeTask(sink, spin));
+                    if (batch.size() == 1024) pool.submitBatch(group, batch);
+                }
+                pool.submitBatch(group, batch);
+                group.wait();
+            });
+            runBenchmark("  work stealing, tasks spawning tasks", taskCount, [&] {
+                // Each root task fans out from inside a worker, onto that worker's own deque
+                TaskGroup group;
+                size_t fanOut = 64;
+                for (size_t i = 0; i < taskCount / fanOut; ++i) {
+                    pool.submit(group, [&pool, &group, &sink, spin, fanOut] {
+                        for (size_t j = 1; j < fanOut; ++j) pool.submit(group, makeTask(sink, spin));
+                        makeTask(sink, spin)();
+                    });
+                }
+                group.wait();
+            });
+        }
+    }
+    std::cout << "(checksum " << sink.load() << ")" << std::endl;
+    return 0;
+}
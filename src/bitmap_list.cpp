@@ -0,0 +1,174 @@
+#include "bitmap_list.h"
+#include <algorithm>
+
+bool preferBitmapEncoding(const std::vector<std::pair<int, float>> &postings) {
+    if (postings.size() < static_cast<size_t>(BITMAP_LIST_MIN_POSTINGS)) {
+        return false;
+    }
+    int64_t span = static_cast<int64_t>(postings.back().first) - postings.front().first + 1;
+    return static_cast<int64_t>(postings.size()) * BITMAP_LIST_MIN_DENSITY >= span;
+}
+
+int encodeBitmapList(const std::vector<std::pair<int, float>> &postings, std::vector<unsigned char> &out) {
+    out.clear();
+
+    // Split the postings into chunks sharing the high 16 bits
+    std::vector<BitmapChunk> chunks;
+    for (size_t i = 0; i < postings.size(); ++i) {
+        uint16_t key = static_cast<uint16_t>(postings[i].first >> BITMAP_CHUNK_BITS);
+        if (chunks.empty() || chunks.back().key != key) {
+            chunks.push_back({key, BITMAP_CONTAINER_ARRAY, 0, static_cast<uint32_t>(i), 0});
+        }
+        chunks.back().cardinality++;
+    }
+
+    size_t tableSize = chunks.size() * sizeof(BitmapChunk);
+    out.resize(tableSize);
+    for (BitmapChunk &chunk : chunks) {
+        chunk.offset = static_cast<uint32_t>(out.size() - tableSize);
+        size_t start = out.size();
+        if (chunk.cardinality > BITMAP_CONTAINER_MIN) {
+            chunk.type = BITMAP_CONTAINER_BITMAP;
+            std::vector<uint64_t> words(BITMAP_CHUNK_WORDS, 0);
+            for (uint32_t i = chunk.firstPosting; i < chunk.firstPosting + chunk.cardinality; ++i) {
+                int low = postings[i].first & 0xFFFF;
+                words[low >> 6] |= uint64_t(1) << (low & 63);
+            }
+            out.resize(start + BITMAP_CHUNK_WORDS * sizeof(uint64_t));
+            std::memcpy(out.data() + start, words.data(), BITMAP_CHUNK_WORDS * sizeof(uint64_t));
+        } else {
+            out.resize(start + chunk.cardinality * sizeof(uint16_t));
+            for (uint32_t i = 0; i < chunk.cardinality; ++i) {
+                uint16_t low = static_cast<uint16_t>(postings[chunk.firstPosting + i].first & 0xFFFF);
+                std::memcpy(out.data() + start + i * sizeof(uint16_t), &low, sizeof(uint16_t));
+            }
+        }
+    }
+    std::memcpy(out.data(), chunks.data(), tableSize);
+
+    // Scores of all postings, in docID order
+    size_t scoresStart = out.size();
+    out.resize(scoresStart + postings.size() * sizeof(float));
+    for (size_t i = 0; i < postings.size(); ++i) {
+        std::memcpy(out.data() + scoresStart + i * sizeof(float), &postings[i].second, sizeof(float));
+    }
+    return static_cast<int>(chunks.size());
+}
+
+// --- BitmapListCursor ---
+
+void BitmapListCursor::open(const unsigned char *list, int chunkCount, int docFrequency, int length) {
+    this->chunkCount = chunkCount;
+    chunkTable = list;
+    containers = list + chunkCount * sizeof(BitmapChunk);
+    scores = list + length - docFrequency * sizeof(float);
+    currentDocID = -1;
+    enterChunk(0);
+}
+
+void BitmapListCursor::enterChunk(int index) {
+    chunkIndex = index;
+    chunk = chunkEntry(index);
+    container = containers + chunk.offset;
+    consumed = 0;
+    if (chunk.type == BITMAP_CONTAINER_BITMAP) {
+        wordIndex = 0;
+        wordBits = word(0);
+    }
+}
+
+bool BitmapListCursor::nextInChunk() {
+    int low;
+    if (chunk.type == BITMAP_CONTAINER_BITMAP) {
+        while (wordBits == 0) {
+            if (++wordIndex >= BITMAP_CHUNK_WORDS) return false;
+            wordBits = word(wordIndex);
+        }
+        low = (wordIndex << 6) | __builtin_ctzll(wordBits);
+        wordBits &= wordBits - 1;
+    } else {
+        if (consumed >= chunk.cardinality) return false;
+        low = arrayValue(consumed);
+    }
+    consumed++;
+    currentDocID = (static_cast<int>(chunk.key) << BITMAP_CHUNK_BITS) | low;
+    return true;
+}
+
+// Move to the first posting of the current chunk whose low bits are >= low
+bool BitmapListCursor::seekInChunk(int low) {
+    if (chunk.type == BITMAP_CONTAINER_BITMAP) {
+        // Count the postings passed over so the score index stays right
+        int target = low >> 6;
+        if (target > wordIndex) {
+            consumed += __builtin_popcountll(wordBits);
+            for (int i = wordIndex + 1; i < target; ++i) {
+                consumed += __builtin_popcountll(word(i));
+            }
+            wordIndex = target;
+            wordBits = word(target);
+        }
+        uint64_t skipped = wordBits & ((uint64_t(1) << (low & 63)) - 1);
+        consumed += __builtin_popcountll(skipped);
+        wordBits &= ~skipped;
+    } else {
+        // Gallop, then binary search, over the unvisited part of the array
+        uint32_t begin = consumed, end = chunk.cardinality, step = 1;
+        while (begin + step < end && arrayValue(begin + step) < low) {
+            begin += step;
+            step <<= 1;
+        }
+        end = std::min(end, begin + step + 1);
+        while (begin < end) {
+            uint32_t mid = begin + (end - begin) / 2;
+            if (arrayValue(mid) < low) {
+                begin = mid + 1;
+            } else {
+                end = mid;
+            }
+        }
+        consumed = begin;
+    }
+    return nextInChunk();
+}
+
+bool BitmapListCursor::next() {
+    while (!nextInChunk()) {
+        if (chunkIndex + 1 >= chunkCount) return false;
+        enterChunk(chunkIndex + 1);
+    }
+    return true;
+}
+
+bool BitmapListCursor::nextGEQ(int docID) {
+    if (currentDocID >= docID) return true;
+
+    int key = docID >> BITMAP_CHUNK_BITS;
+    if (chunk.key < key) {
+        // Gallop over the chunk table to the first chunk with key >= key
+        int low = chunkIndex, step = 1, high = chunkIndex + 1;
+        while (high < chunkCount && chunkEntry(high).key < key) {
+            low = high;
+            step <<= 1;
+            high = low + step;
+        }
+        if (high > chunkCount) high = chunkCount;
+        while (low + 1 < high) {
+            int mid = low + (high - low) / 2;
+            if (chunkEntry(mid).key < key) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        if (high >= chunkCount) return false;
+        enterChunk(high);
+    }
+    if (chunk.key > key) return nextInChunk();
+
+    if (seekInChunk(docID & 0xFFFF)) return true;
+    // Nothing left in this chunk: the answer is the first posting of the next one
+    if (chunkIndex + 1 >= chunkCount) return false;
+    enterChunk(chunkIndex + 1);
+    return nextInChunk();
+}
@@ -0,0 +1,80 @@
+#include "champion_lists.h"
+#include "inverted_index.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+std::string championListsFilename(const std::string &lexiconFilename) {
+    std::string base = lexiconFilename;
+    if (base.size() > 4 && base.compare(base.size() - 4, 4, ".bin") == 0) {
+        base.resize(base.size() - 4);
+    }
+    return base + "_champions.bin";
+}
+
+bool buildChampionLists(const std::string &indexFilename, const std::string &lexiconFilename, const std::string &outputFilename) {
+    InvertedIndex index(indexFilename, lexiconFilename);
+    Lexicon lexicon;
+    if (!lexicon.open(lexiconFilename)) {
+        return false;
+    }
+    std::vector<int> docBuffer(MAX_BLOCK_POSTINGS);
+    int32_t minDocFrequency = std::max<int32_t>(CHAMPION_MIN_DOC_FREQUENCY, CHAMPION_LIST_SIZE);
+
+    std::vector<uint32_t> slots(lexicon.size(), NO_CHAMPIONS);
+    std::vector<ChampionEntry> entries, postings;
+    uint32_t listCount = 0;
+    for (uint32_t term = 0; term < lexicon.size(); ++term) {
+        if (lexicon.record(term).docFrequency < minDocFrequency) continue;
+        postings.clear();
+        InvertedListPointer cursor = index.openList(term, docBuffer.data());
+        while (cursor.next()) {
+            float score = cursor.getIDF() * cursor.getTFS();
+            postings.push_back({cursor.getDocID(), score});
+        }
+        if (postings.size() < CHAMPION_LIST_SIZE) continue;
+
+        // Best first; equal scores keep the lower docID
+        std::partial_sort(postings.begin(), postings.begin() + CHAMPION_LIST_SIZE, postings.end(),
+                          [](const ChampionEntry &a, const ChampionEntry &b) {
+                              return a.score != b.score ? a.score > b.score : a.docID < b.docID;
+                          });
+        entries.insert(entries.end(), postings.begin(), postings.begin() + CHAMPION_LIST_SIZE);
+        slots[term] = listCount++;
+    }
+
+    std::ofstream output(outputFilename, std::ios::binary);
+    if (!output) {
+        std::cerr << "Error opening champion lists file: " << outputFilename << std::endl;
+        return false;
+    }
+    ChampionListsHeader header = {CHAMPION_LISTS_MAGIC, lexicon.size(), CHAMPION_LIST_SIZE, listCount};
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char *>(slots.data()), slots.size() * sizeof(uint32_t));
+    output.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(ChampionEntry));
+    std::cout << "Champion lists written to " << outputFilename << " (" << listCount << " terms with at least "
+              << minDocFrequency << " postings)." << std::endl;
+    return true;
+}
+
+// --- ChampionLists ---
+
+bool ChampionLists::open(const std::string &filename) {
+    header = nullptr;
+    if (!file.open(filename)) {
+        return false;
+    }
+    const ChampionListsHeader *fileHeader = reinterpret_cast<const ChampionListsHeader *>(file.data());
+    if (file.size() < sizeof(ChampionListsHeader) || fileHeader->magic != CHAMPION_LISTS_MAGIC ||
+        file.size() < sizeof(ChampionListsHeader) + fileHeader->termCount * sizeof(uint32_t) +
+                          static_cast<size_t>(fileHeader->listCount) * fileHeader->listSize * sizeof(ChampionEntry)) {
+        std::cerr << "Invalid champion lists (rebuild them): " << filename << std::endl;
+        file.close();
+        return false;
+    }
+    header = fileHeader;
+    slots = reinterpret_cast<const uint32_t *>(file.data() + sizeof(ChampionListsHeader));
+    entries = reinterpret_cast<const ChampionEntry *>(slots + header->termCount);
+    return true;
+}
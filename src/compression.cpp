@@ -56,3 +56,17 @@ int varbyteDecodeNumber(const std::vector<unsigned char> &data, size_t &pos) {
     return number;
 }
 
+// Decode one number from raw (e.g. memory-mapped) bytes; the caller guarantees the bytes are there
+int varbyteDecodeNumber(const unsigned char *data, size_t &pos) {
+    int number = 0;
+    int shift = 0;
+    while (true) {
+        unsigned char byte = data[pos++];
+        number |= (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+        shift += 7;
+    }
+    return number;
+}
@@ -0,0 +1,145 @@
+// Deletes documents from the index: marks them in the tombstones of the segments holding
+// them. Running query processors stop returning them right away; their postings go at the
+// next merge of the segment (temp_file_merger --compact).
+//
+// Usage: delete_docs [--names] [ID...]
+// IDs are global docIDs, or document names with --names; without any on the command line
+// they are read from stdin, one per line.
+#include "segment_manifest.h"
+#include "tombstones.h"
+#include "doc_tables.h"
+#include "logger.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Give up when the segments are replaced under us this many times in a row
+const int MAX_ATTEMPTS = 10;
+
+// -1 while there is no manifest
+static int64_t manifestGeneration() {
+    SegmentManifest manifest;
+    return readManifest(SEGMENT_MANIFEST_FILENAME, manifest) ? manifest.generation : -1;
+}
+
+// Local docIDs to delete in each segment of the manifest
+static bool resolveDeletes(const SegmentManifest &manifest, const std::vector<std::string> &ids, bool byName,
+                           std::vector<std::vector<int>> &deletes, size_t &resolved) {
+    deletes.assign(manifest.segments.size(), std::vector<int>());
+    resolved = 0;
+    if (byName) {
+        std::unordered_set<std::string> names(ids.begin(), ids.end());
+        char nameBuffer[16];
+        for (size_t s = 0; s < manifest.segments.size(); ++s) {
+            PageTable pageTable;
+            if (!pageTable.open(segmentFile(manifest.segments[s].directory, "page_table.bin"))) {
+                return false;
+            }
+            for (uint64_t doc = 0; doc < pageTable.size(); ++doc) {
+                if (names.count(std::string(pageTable.docName(static_cast<int>(doc), nameBuffer)))) {
+                    deletes[s].push_back(static_cast<int>(doc));
+                    resolved++;
+                }
+            }
+        }
+    } else {
+        for (const std::string &id : ids) {
+            int64_t docID = std::strtoll(id.c_str(), nullptr, 10);
+            size_t s = 0;
+            while (s < manifest.segments.size() && docID >= manifest.segments[s].docBase + manifest.segments[s].docCount) {
+                s++;
+            }
+            if (docID < 0 || s == manifest.segments.size()) {
+                std::cerr << "No document with docID " << id << std::endl;
+                continue;
+            }
+            deletes[s].push_back(static_cast<int>(docID - manifest.segments[s].docBase));
+            resolved++;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    startLogging("../logs/delete_docs.log");
+    bool byName = false;
+    std::vector<std::string> ids;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--names") {
+            byName = true;
+        } else {
+            ids.push_back(arg);
+        }
+    }
+    if (ids.empty()) {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            if (!line.empty()) ids.push_back(line);
+        }
+    }
+
+    // A merge that replaces segments while we mark them makes us start over on the new manifest
+    int64_t deleted = 0;
+    size_t resolved = 0;
+    for (int attempt = 0;; ++attempt) {
+        SegmentManifest manifest;
+        int64_t generation = -1;
+        if (readManifest(SEGMENT_MANIFEST_FILENAME, manifest)) {
+            generation = manifest.generation;
+        } else {
+            // No segments: the batch index is the whole collection
+            SegmentInfo base;
+            base.directory = SEGMENT_BASE_DIRECTORY;
+            DocLengthTable docLengths;
+            if (!docLengths.open(segmentFile(base.directory, "doc_lengths.bin"))) {
+                return 1;
+            }
+            base.docCount = static_cast<int64_t>(docLengths.size());
+            manifest.segments.push_back(base);
+        }
+        std::vector<std::vector<int>> deletes;
+        if (!resolveDeletes(manifest, ids, byName, deletes, resolved)) {
+            return 1;
+        }
+
+        auto stillListed = [generation] { return manifestGeneration() == generation; };
+        bool moved = false;
+        for (size_t s = 0; s < manifest.segments.size() && !moved; ++s) {
+            if (deletes[s].empty()) continue;
+            const SegmentInfo &segment = manifest.segments[s];
+            std::string filename = tombstonesFilename(segmentFile(segment.directory, "index.bin"));
+            Tombstones existing;
+            if (!existing.open(filename) && stillListed()) {
+                // Index built before tombstones existed; query processors see the file once restarted
+                std::cout << "Creating " << filename << std::endl;
+                if (!writeTombstones(filename, segment.docCount)) {
+                    return 1;
+                }
+            }
+            int64_t segmentDeleted = deleteDocuments(filename, deletes[s].data(), deletes[s].size(), stillListed);
+            if (segmentDeleted == TOMBSTONES_MOVED) {
+                moved = true;
+            } else if (segmentDeleted < 0) {
+                return 1;
+            } else {
+                deleted += segmentDeleted;
+            }
+        }
+        if (!moved) {
+            break;
+        }
+        if (attempt + 1 == MAX_ATTEMPTS) {
+            std::cerr << "Segments kept changing; " << deleted << " documents deleted so far" << std::endl;
+            return 1;
+        }
+        LOG_INFO("Segments merged while deleting; resolving the documents again");
+    }
+
+    std::cout << "Deleted " << deleted << " documents (" << resolved << " of " << ids.size() << " found, "
+              << static_cast<int64_t>(resolved) - deleted << " already deleted)" << std::endl;
+    LOG_INFO("Deleted " + std::to_string(deleted) + " documents");
+    return 0;
+}
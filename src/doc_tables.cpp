@@ -0,0 +1,63 @@
+#include "doc_tables.h"
+#include <charconv>
+#include <iostream>
+
+bool DocLengthTable::open(const std::string &filename) {
+    header = nullptr;
+    if (!file.open(filename)) {
+        std::cerr << "Error opening document lengths file: " << filename << std::endl;
+        return false;
+    }
+    const DocLengthsHeader *fileHeader = reinterpret_cast<const DocLengthsHeader *>(file.data());
+    if (file.size() < sizeof(DocLengthsHeader) || fileHeader->magic != DOC_LENGTHS_MAGIC ||
+        file.size() < sizeof(DocLengthsHeader) + fileHeader->docCount * sizeof(int32_t)) {
+        std::cerr << "Invalid document lengths file (rebuild the index): " << filename << std::endl;
+        file.close();
+        return false;
+    }
+    header = fileHeader;
+    lengths = reinterpret_cast<const int32_t *>(file.data() + sizeof(DocLengthsHeader));
+    return true;
+}
+
+bool PageTable::open(const std::string &filename) {
+    header = nullptr;
+    if (!file.open(filename)) {
+        std::cerr << "Error opening page table file: " << filename << std::endl;
+        return false;
+    }
+    const PageTableHeader *fileHeader = reinterpret_cast<const PageTableHeader *>(file.data());
+    if (file.size() < sizeof(PageTableHeader) || fileHeader->magic != PAGE_TABLE_MAGIC) {
+        std::cerr << "Invalid page table file (rebuild the index): " << filename << std::endl;
+        file.close();
+        return false;
+    }
+
+    const unsigned char *body = file.data() + sizeof(PageTableHeader);
+    size_t tableSize = fileHeader->numericNames ? fileHeader->docCount * sizeof(uint32_t)
+                                                : (fileHeader->docCount + 1) * sizeof(uint64_t);
+    if (file.size() < sizeof(PageTableHeader) + tableSize) {
+        std::cerr << "Truncated page table file: " << filename << std::endl;
+        file.close();
+        return false;
+    }
+    header = fileHeader;
+    if (header->numericNames) {
+        numericIDs = reinterpret_cast<const uint32_t *>(body);
+    } else {
+        nameOffsets = reinterpret_cast<const uint64_t *>(body);
+        nameBlob = reinterpret_cast<const char *>(body + tableSize);
+    }
+    return true;
+}
+
+std::string_view PageTable::docName(int docID, char *buffer) const {
+    if (!header || docID < 0 || static_cast<uint64_t>(docID) >= header->docCount) {
+        return std::string_view();
+    }
+    if (numericIDs) {
+        auto [end, ec] = std::to_chars(buffer, buffer + 16, numericIDs[docID]);
+        return std::string_view(buffer, ec == std::errc() ? end - buffer : 0);
+    }
+    return std::string_view(nameBlob + nameOffsets[docID], nameOffsets[docID + 1] - nameOffsets[docID]);
+}
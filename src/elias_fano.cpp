@@ -0,0 +1,265 @@
+#include "elias_fano.h"
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// Section sizes of one partition
+struct PartitionLayout {
+    uint8_t lowBits;
+    uint32_t lowerWords;
+    uint32_t upperWords;
+    uint32_t sampleCount;
+    size_t bytes() const {
+        return (lowerWords + upperWords) * sizeof(uint64_t) + sampleCount * sizeof(uint16_t);
+    }
+};
+
+PartitionLayout partitionLayout(uint32_t count, uint32_t maxValue) {
+    PartitionLayout layout;
+    // l = floor(log2(universe / count)) keeps the upper bits below 2 * count + 1
+    uint64_t universe = static_cast<uint64_t>(maxValue) + 1;
+    layout.lowBits = universe > count ? static_cast<uint8_t>(63 - __builtin_clzll(universe / count)) : 0;
+    uint64_t zeros = (maxValue >> layout.lowBits) + 1;
+    layout.lowerWords = static_cast<uint32_t>((static_cast<uint64_t>(count) * layout.lowBits + 63) / 64);
+    layout.upperWords = static_cast<uint32_t>((count + zeros + 63) / 64);
+    layout.sampleCount = static_cast<uint32_t>((zeros + EF_SELECT_SAMPLE - 1) / EF_SELECT_SAMPLE);
+    return layout;
+}
+
+// Values of postings [begin, end) are stored relative to the docID after the previous partition
+int32_t partitionBase(const std::vector<std::pair<int, float>> &postings, size_t begin) {
+    return begin == 0 ? postings[0].first : postings[begin - 1].first + 1;
+}
+
+size_t partitionCost(const std::vector<std::pair<int, float>> &postings, size_t begin, size_t end) {
+    uint32_t maxValue = static_cast<uint32_t>(postings[end - 1].first - partitionBase(postings, begin));
+    return partitionLayout(static_cast<uint32_t>(end - begin), maxValue).bytes() + sizeof(EliasFanoPartition);
+}
+
+// Pick partition ends minimizing the total size: dynamic programming over cut points at
+// multiples of EF_PARTITION_STEP, with partitions of at most EF_MAX_PARTITION postings
+std::vector<size_t> choosePartitions(const std::vector<std::pair<int, float>> &postings) {
+    size_t n = postings.size();
+    size_t cuts = (n + EF_PARTITION_STEP - 1) / EF_PARTITION_STEP;
+    const size_t maxSteps = EF_MAX_PARTITION / EF_PARTITION_STEP;
+    auto cutPosition = [&](size_t cut) { return std::min(cut * EF_PARTITION_STEP, n); };
+
+    std::vector<size_t> best(cuts + 1, std::numeric_limits<size_t>::max());
+    std::vector<size_t> previous(cuts + 1, 0);
+    best[0] = 0;
+    for (size_t cut = 1; cut <= cuts; ++cut) {
+        size_t first = cut > maxSteps ? cut - maxSteps : 0;
+        for (size_t from = first; from < cut; ++from) {
+            size_t cost = best[from] + partitionCost(postings, cutPosition(from), cutPosition(cut));
+            if (cost < best[cut]) {
+                best[cut] = cost;
+                previous[cut] = from;
+            }
+        }
+    }
+
+    std::vector<size_t> ends;
+    for (size_t cut = cuts; cut > 0; cut = previous[cut]) {
+        ends.push_back(cutPosition(cut));
+    }
+    std::reverse(ends.begin(), ends.end());
+    return ends;
+}
+
+void setBit(std::vector<uint64_t> &words, uint64_t bit) {
+    words[bit / 64] |= uint64_t(1) << (bit % 64);
+}
+
+} // namespace
+
+int encodeEliasFanoList(const std::vector<std::pair<int, float>> &postings, std::vector<unsigned char> &out) {
+    out.clear();
+    std::vector<size_t> ends = choosePartitions(postings);
+    size_t tableSize = ends.size() * sizeof(EliasFanoPartition);
+    out.resize(tableSize);
+
+    std::vector<uint64_t> lower, upper;
+    std::vector<uint16_t> samples;
+    size_t begin = 0;
+    for (size_t p = 0; p < ends.size(); ++p) {
+        size_t end = ends[p];
+        EliasFanoPartition entry = {};
+        entry.maxDocID = postings[end - 1].first;
+        entry.base = partitionBase(postings, begin);
+        entry.offset = static_cast<uint32_t>(out.size() - tableSize);
+        entry.firstPosting = static_cast<uint32_t>(begin);
+        entry.count = static_cast<uint16_t>(end - begin);
+        PartitionLayout layout = partitionLayout(entry.count, static_cast<uint32_t>(entry.maxDocID - entry.base));
+        entry.lowBits = layout.lowBits;
+
+        lower.assign(layout.lowerWords, 0);
+        upper.assign(layout.upperWords, 0);
+        for (size_t i = begin; i < end; ++i) {
+            uint64_t value = static_cast<uint64_t>(postings[i].first - entry.base);
+            uint64_t element = i - begin;
+            for (int bit = 0; bit < layout.lowBits; ++bit) {
+                if (value >> bit & 1) setBit(lower, element * layout.lowBits + bit);
+            }
+            setBit(upper, (value >> layout.lowBits) + element);
+        }
+
+        // Position of every EF_SELECT_SAMPLE-th zero of the upper bits
+        samples.clear();
+        uint64_t zeros = 0;
+        for (uint64_t bit = 0; samples.size() < layout.sampleCount; ++bit) {
+            if (!(upper[bit / 64] >> (bit % 64) & 1)) {
+                if (zeros % EF_SELECT_SAMPLE == 0) samples.push_back(static_cast<uint16_t>(bit));
+                zeros++;
+            }
+        }
+
+        size_t start = out.size();
+        out.resize(start + layout.bytes());
+        unsigned char *data = out.data() + start;
+        std::memcpy(data, lower.data(), lower.size() * sizeof(uint64_t));
+        data += lower.size() * sizeof(uint64_t);
+        std::memcpy(data, upper.data(), upper.size() * sizeof(uint64_t));
+        data += upper.size() * sizeof(uint64_t);
+        std::memcpy(data, samples.data(), samples.size() * sizeof(uint16_t));
+
+        std::memcpy(out.data() + p * sizeof(EliasFanoPartition), &entry, sizeof(EliasFanoPartition));
+        begin = end;
+    }
+
+    // Scores of all postings, in docID order
+    size_t scoresStart = out.size();
+    out.resize(scoresStart + postings.size() * sizeof(float));
+    for (size_t i = 0; i < postings.size(); ++i) {
+        std::memcpy(out.data() + scoresStart + i * sizeof(float), &postings[i].second, sizeof(float));
+    }
+    return static_cast<int>(ends.size());
+}
+
+// --- EliasFanoCursor ---
+
+void EliasFanoCursor::open(const unsigned char *list, int partitionCount, int docFrequency, int length) {
+    this->partitionCount = partitionCount;
+    partitionTable = list;
+    partitionData = list + partitionCount * sizeof(EliasFanoPartition);
+    scores = list + length - docFrequency * sizeof(float);
+    currentDocID = -1;
+    enterPartition(0);
+}
+
+void EliasFanoCursor::enterPartition(int partitionIndex) {
+    this->partitionIndex = partitionIndex;
+    partition = partitionEntry(partitionIndex);
+    PartitionLayout layout = partitionLayout(partition.count, static_cast<uint32_t>(partition.maxDocID - partition.base));
+    lower = partitionData + partition.offset;
+    upper = lower + layout.lowerWords * sizeof(uint64_t);
+    zeroSamples = upper + layout.upperWords * sizeof(uint64_t);
+    index = -1;
+    wordIndex = 0;
+    wordBits = upperWord(0);
+    currentHigh = 0;
+}
+
+uint32_t EliasFanoCursor::lowerValue(int elementIndex) const {
+    if (partition.lowBits == 0) return 0;
+    uint64_t bit = static_cast<uint64_t>(elementIndex) * partition.lowBits;
+    uint64_t word;
+    std::memcpy(&word, lower + (bit / 64) * sizeof(uint64_t), sizeof(uint64_t));
+    uint64_t value = word >> (bit % 64);
+    if (bit % 64 + partition.lowBits > 64) {
+        std::memcpy(&word, lower + (bit / 64 + 1) * sizeof(uint64_t), sizeof(uint64_t));
+        value |= word << (64 - bit % 64);
+    }
+    return static_cast<uint32_t>(value & ((uint64_t(1) << partition.lowBits) - 1));
+}
+
+bool EliasFanoCursor::nextInPartition() {
+    if (index + 1 >= partition.count) return false;
+    while (wordBits == 0) {
+        wordBits = upperWord(++wordIndex);
+    }
+    int position = (wordIndex << 6) | __builtin_ctzll(wordBits);
+    wordBits &= wordBits - 1;
+    index++;
+    currentHigh = position - index;
+    currentDocID = partition.base + static_cast<int>((currentHigh << partition.lowBits) | lowerValue(index));
+    return true;
+}
+
+void EliasFanoCursor::seekHigh(uint32_t high) {
+    if (high == 0) {
+        index = -1;
+        wordIndex = 0;
+        wordBits = upperWord(0);
+        return;
+    }
+
+    // Select the high-th zero (1-based): start at the nearest sample, then count zeros word by word
+    uint32_t zero = high - 1;
+    uint16_t sample;
+    std::memcpy(&sample, zeroSamples + (zero / EF_SELECT_SAMPLE) * sizeof(uint16_t), sizeof(uint16_t));
+    uint32_t remaining = zero % EF_SELECT_SAMPLE;
+    int word = sample / 64;
+    uint64_t zeroBits = ~upperWord(word) & (~uint64_t(0) << (sample % 64));
+    uint32_t count = __builtin_popcountll(zeroBits);
+    while (remaining >= count) {
+        remaining -= count;
+        zeroBits = ~upperWord(++word);
+        count = __builtin_popcountll(zeroBits);
+    }
+    for (; remaining > 0; --remaining) {
+        zeroBits &= zeroBits - 1;
+    }
+    int zeroPosition = (word << 6) | __builtin_ctzll(zeroBits);
+
+    // high zeros and zeroPosition + 1 - high elements come up to and including zeroPosition
+    index = zeroPosition - static_cast<int>(high);
+    wordIndex = word;
+    wordBits = upperWord(word) & (~uint64_t(0) << (zeroPosition % 64));
+}
+
+bool EliasFanoCursor::next() {
+    while (!nextInPartition()) {
+        if (partitionIndex + 1 >= partitionCount) return false;
+        enterPartition(partitionIndex + 1);
+    }
+    return true;
+}
+
+bool EliasFanoCursor::nextGEQ(int docID) {
+    if (currentDocID >= docID) return true;
+
+    if (partition.maxDocID < docID) {
+        // Gallop over the partition table to the first partition ending at or after docID
+        int low = partitionIndex, step = 1, high = partitionIndex + 1;
+        while (high < partitionCount && partitionEntry(high).maxDocID < docID) {
+            low = high;
+            step <<= 1;
+            high = low + step;
+        }
+        if (high > partitionCount) high = partitionCount;
+        while (low + 1 < high) {
+            int mid = low + (high - low) / 2;
+            if (partitionEntry(mid).maxDocID < docID) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        if (high >= partitionCount) return false;
+        enterPartition(high);
+    }
+    if (docID <= partition.base) {
+        return nextInPartition();  // docID falls in the gap before this partition
+    }
+
+    // Jump straight to the first element with a large enough high part, then scan its bucket
+    uint32_t high = static_cast<uint32_t>(docID - partition.base) >> partition.lowBits;
+    if (index < 0 || high > currentHigh) {
+        seekHigh(high);
+    }
+    while (nextInPartition()) {
+        if (currentDocID >= docID) return true;
+    }
+    return false;  // Not reached: the partition's last docID is >= docID
+}
@@ -0,0 +1,187 @@
+#include "graph_bisection.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+namespace {
+
+// Per-thread term state, all zero between bisection steps. Only the terms of the partition
+// being split are touched, and they are reset before recursing, so one buffer serves a
+// whole thread's share of the recursion.
+struct BisectionScratch {
+    std::vector<uint32_t> degree[2];  // Documents in the left and right half containing the term
+    std::vector<double> moveGain[2];  // Cost saved by moving a document with the term across
+    std::vector<uint32_t> touched;
+
+    void reserve(uint32_t termCount) {
+        if (degree[0].size() >= termCount) return;
+        for (int side = 0; side < 2; ++side) {
+            degree[side].assign(termCount, 0);
+            moveGain[side].assign(termCount, 0.0);
+        }
+    }
+};
+
+BisectionScratch &localScratch() {
+    static thread_local BisectionScratch scratch;
+    return scratch;
+}
+
+// Estimated bits for the gaps of a term with degree postings among n documents
+inline double gapCost(double degree, double n) {
+    return degree * std::log2(n / (degree + 1));
+}
+
+class Bisector {
+public:
+    Bisector(const ForwardIndex &graph, ThreadPool &pool, const BisectionOptions &options)
+        : graph(graph), pool(pool), options(options) {}
+
+    void bisect(uint32_t *docs, size_t n, int depth) {
+        if (n <= options.minPartition || (options.maxDepth > 0 && depth >= options.maxDepth)) return;
+        size_t half = n / 2;
+        refine(docs, n, half);
+
+        if (n >= options.parallelMinDocs) {
+            TaskGroup halves;
+            pool.submit(halves, [this, docs, half, depth] { bisect(docs, half, depth + 1); });
+            bisect(docs + half, n - half, depth + 1);
+            halves.wait();
+        } else {
+            bisect(docs, half, depth + 1);
+            bisect(docs + half, n - half, depth + 1);
+        }
+    }
+
+private:
+    const uint32_t *termsBegin(uint32_t doc) const { return graph.terms.data() + graph.offsets[doc]; }
+    const uint32_t *termsEnd(uint32_t doc) const { return graph.terms.data() + graph.offsets[doc + 1]; }
+
+    // Swap documents between docs[0, half) and docs[half, n) while that lowers the cost
+    void refine(uint32_t *docs, size_t n, size_t half) {
+        BisectionScratch &scratch = localScratch();
+        scratch.reserve(graph.termCount);
+        std::vector<uint32_t> *degree = scratch.degree;
+        std::vector<double> *moveGain = scratch.moveGain;
+        std::vector<uint32_t> &touched = scratch.touched;
+        touched.clear();
+
+        for (size_t i = 0; i < n; ++i) {
+            int side = i < half ? 0 : 1;
+            for (const uint32_t *t = termsBegin(docs[i]); t != termsEnd(docs[i]); ++t) {
+                if (degree[0][*t] == 0 && degree[1][*t] == 0) touched.push_back(*t);
+                ++degree[side][*t];
+            }
+        }
+
+        const double sizes[2] = {static_cast<double>(half), static_cast<double>(n - half)};
+        std::vector<std::pair<double, uint32_t>> candidates[2];
+        candidates[0].resize(half);
+        candidates[1].resize(n - half);
+
+        for (int iteration = 0; iteration < options.iterations; ++iteration) {
+            for (uint32_t t : touched) {
+                double from = degree[0][t], to = degree[1][t];
+                double before = gapCost(from, sizes[0]) + gapCost(to, sizes[1]);
+                moveGain[0][t] = from > 0 ? before - gapCost(from - 1, sizes[0]) - gapCost(to + 1, sizes[1]) : 0.0;
+                moveGain[1][t] = to > 0 ? before - gapCost(from + 1, sizes[0]) - gapCost(to - 1, sizes[1]) : 0.0;
+            }
+
+            computeGains(docs, n, half, moveGain, candidates);
+            for (int side = 0; side < 2; ++side) {
+                std::sort(candidates[side].begin(), candidates[side].end(),
+                          [](const std::pair<double, uint32_t> &a, const std::pair<double, uint32_t> &b) {
+                              return a.first > b.first || (a.first == b.first && a.second < b.second);
+                          });
+            }
+
+            // Swap the best pairs while a swap still pays for itself
+            size_t swaps = 0;
+            for (size_t i = 0; i < candidates[0].size() && i < candidates[1].size(); ++i) {
+                if (candidates[0][i].first + candidates[1][i].first <= 0) break;
+                uint32_t left = candidates[0][i].second, right = candidates[1][i].second;
+                for (const uint32_t *t = termsBegin(left); t != termsEnd(left); ++t) {
+                    --degree[0][*t];
+                    ++degree[1][*t];
+                }
+                for (const uint32_t *t = termsBegin(right); t != termsEnd(right); ++t) {
+                    --degree[1][*t];
+                    ++degree[0][*t];
+                }
+                std::swap(candidates[0][i].second, candidates[1][i].second);
+                ++swaps;
+            }
+            for (size_t i = 0; i < half; ++i) docs[i] = candidates[0][i].second;
+            for (size_t i = half; i < n; ++i) docs[i] = candidates[1][i - half].second;
+            if (swaps == 0) break;
+        }
+
+        for (uint32_t t : touched) {
+            degree[0][t] = degree[1][t] = 0;
+            moveGain[0][t] = moveGain[1][t] = 0.0;
+        }
+        touched.clear();
+    }
+
+    // Gain of moving each document to the other half; large partitions are split into chunks
+    // for the pool, reading this thread's moveGain
+    void computeGains(const uint32_t *docs, size_t n, size_t half, const std::vector<double> *moveGain,
+                      std::vector<std::pair<double, uint32_t>> *candidates) {
+        auto gainsOf = [this, docs, half, moveGain, candidates](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                int side = i < half ? 0 : 1;
+                double gain = 0;
+                for (const uint32_t *t = termsBegin(docs[i]); t != termsEnd(docs[i]); ++t) {
+                    gain += moveGain[side][*t];
+                }
+                candidates[side][side == 0 ? i : i - half] = {gain, docs[i]};
+            }
+        };
+
+        const size_t chunk = options.parallelMinDocs;
+        if (n < 2 * chunk) {
+            gainsOf(0, n);
+            return;
+        }
+        TaskGroup chunks;
+        for (size_t begin = chunk; begin < n; begin += chunk) {
+            pool.submit(chunks, [gainsOf, begin, n, chunk] { gainsOf(begin, std::min(n, begin + chunk)); });
+        }
+        gainsOf(0, chunk);
+        chunks.wait();
+    }
+
+    const ForwardIndex &graph;
+    ThreadPool &pool;
+    const BisectionOptions &options;
+};
+
+} // namespace
+
+std::vector<uint32_t> graphBisectionOrder(const ForwardIndex &graph, ThreadPool &pool, const BisectionOptions &options) {
+    std::vector<uint32_t> order(graph.docCount());
+    std::iota(order.begin(), order.end(), 0);
+    Bisector(graph, pool, options).bisect(order.data(), order.size(), 0);
+    return order;
+}
+
+GapStats computeGapStats(const ForwardIndex &graph, const std::vector<uint32_t> &order) {
+    GapStats stats;
+    std::vector<int64_t> last(graph.termCount, -1);
+    for (size_t newID = 0; newID < order.size(); ++newID) {
+        uint32_t doc = order[newID];
+        for (uint64_t p = graph.offsets[doc]; p < graph.offsets[doc + 1]; ++p) {
+            uint32_t t = graph.terms[p];
+            uint64_t gap = static_cast<uint64_t>(static_cast<int64_t>(newID) - last[t]);
+            last[t] = static_cast<int64_t>(newID);
+            ++stats.postings;
+            stats.logGapBits += std::log2(static_cast<double>(gap) + 1);
+            do {
+                ++stats.varbyteBytes;
+                gap >>= 7;
+            } while (gap > 0);
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,109 @@
+#include "impact_index.h"
+#include "compression.h"
+#include "file_write_buffer.h"
+#include "inverted_index.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#define IMPACT_WRITE_CHUNK 40000000 // Write 40MB at a time
+
+std::string impactIndexFilename(const std::string &indexFilename) {
+    size_t slash = indexFilename.find_last_of('/');
+    size_t nameStart = slash == std::string::npos ? 0 : slash + 1;
+    return indexFilename.substr(0, nameStart) + "impact_" + indexFilename.substr(nameStart);
+}
+
+bool buildImpactIndex(const std::string &indexFilename, const std::string &lexiconFilename, const std::string &outputFilename) {
+    InvertedIndex index(indexFilename, lexiconFilename);
+    Lexicon lexicon;
+    if (!lexicon.open(lexiconFilename)) {
+        return false;
+    }
+    std::vector<int> docBuffer(MAX_BLOCK_POSTINGS);
+
+    // First pass: the largest contribution sets the quantization scale
+    float maxImpact = 0;
+    for (uint32_t term = 0; term < lexicon.size(); ++term) {
+        InvertedListPointer cursor = index.openList(term, docBuffer.data());
+        while (cursor.next()) {
+            maxImpact = std::max(maxImpact, cursor.getIDF() * cursor.getTFS());
+        }
+    }
+    if (maxImpact <= 0) {
+        std::cerr << "No positive impacts in " << indexFilename << std::endl;
+        return false;
+    }
+    double scale = static_cast<double>(maxImpact) / IMPACT_LEVELS;
+
+    // Second pass: bucket each list by quantized impact and write the segments
+    WriteFileBuffer output(outputFilename, IMPACT_WRITE_CHUNK);
+    std::vector<ImpactTermEntry> directory(lexicon.size());
+    std::vector<std::vector<int>> buckets(IMPACT_LEVELS + 1);
+    std::vector<ImpactSegment> segments;
+    std::vector<unsigned char> encoded, encodedNumber;
+    uint64_t written = 0;
+    for (uint32_t term = 0; term < lexicon.size(); ++term) {
+        InvertedListPointer cursor = index.openList(term, docBuffer.data());
+        while (cursor.next()) {
+            // Non-positive contributions land in impact 0: they add nothing but still match
+            double impact = cursor.getIDF() * cursor.getTFS();
+            int level = impact > 0 ? std::clamp(static_cast<int>(std::lround(impact / scale)), 1, IMPACT_LEVELS) : 0;
+            buckets[level].push_back(cursor.getDocID());
+        }
+
+        segments.clear();
+        encoded.clear();
+        for (int level = IMPACT_LEVELS; level >= 0; --level) {
+            if (buckets[level].empty()) continue;
+            ImpactSegment segment = {};
+            segment.impact = static_cast<uint16_t>(level);
+            segment.count = static_cast<uint32_t>(buckets[level].size());
+            segment.offset = static_cast<uint32_t>(encoded.size());
+            int lastDocID = 0;
+            for (int docID : buckets[level]) {
+                varbyteEncode(docID - lastDocID, encodedNumber);
+                encoded.insert(encoded.end(), encodedNumber.begin(), encodedNumber.end());
+                lastDocID = docID;
+            }
+            segments.push_back(segment);
+            buckets[level].clear();
+        }
+
+        directory[term] = {written, static_cast<uint32_t>(segments.size()), 0};
+        output.write(reinterpret_cast<const char *>(segments.data()), segments.size() * sizeof(ImpactSegment));
+        output.write(reinterpret_cast<const char *>(encoded.data()), encoded.size());
+        written += segments.size() * sizeof(ImpactSegment) + encoded.size();
+    }
+
+    ImpactIndexFooter footer = {IMPACT_INDEX_MAGIC, lexicon.size(), written, scale};
+    output.write(reinterpret_cast<const char *>(directory.data()), directory.size() * sizeof(ImpactTermEntry));
+    output.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+    std::cout << "Impact index written to " << outputFilename << " (" << IMPACT_LEVELS
+              << " levels, scale " << scale << ")." << std::endl;
+    return true;
+}
+
+// --- ImpactIndex ---
+
+bool ImpactIndex::open(const std::string &filename) {
+    opened = false;
+    if (!file.open(filename)) {
+        return false;
+    }
+    if (file.size() < sizeof(ImpactIndexFooter)) {
+        std::cerr << "Truncated impact index: " << filename << std::endl;
+        file.close();
+        return false;
+    }
+    std::memcpy(&footer, file.data() + file.size() - sizeof(ImpactIndexFooter), sizeof(ImpactIndexFooter));
+    if (footer.magic != IMPACT_INDEX_MAGIC ||
+        footer.directoryOffset + footer.termCount * sizeof(ImpactTermEntry) > file.size() - sizeof(ImpactIndexFooter)) {
+        std::cerr << "Invalid impact index (rebuild it): " << filename << std::endl;
+        file.close();
+        return false;
+    }
+    opened = true;
+    return true;
+}
@@ -0,0 +1,39 @@
+#include "index_warmup.h"
+#include "query_processor.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+bool readWarmupTerms(const std::string &filename, std::vector<std::string> &terms) {
+    std::ifstream log(filename);
+    if (!log.is_open()) {
+        std::cerr << "Error opening query log: " << filename << std::endl;
+        return false;
+    }
+
+    // Terms are normalized as the query processor does, so they match the lexicon
+    std::unordered_map<std::string, size_t> counts;
+    QueryArena &arena = QueryArena::local();
+    std::string line;
+    while (std::getline(log, line)) {
+        if (line == "AND" || line == "and" || line == "OR" || line == "or") continue;
+        arena.reset();
+        std::string_view *queryTerms;
+        size_t termCount = QueryProcessor::parseQuery(line, arena, queryTerms);
+        for (size_t i = 0; i < termCount; ++i) {
+            counts[std::string(queryTerms[i])]++;
+        }
+    }
+
+    std::vector<std::pair<std::string, size_t>> ranked(counts.begin(), counts.end());
+    std::sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    terms.clear();
+    terms.reserve(ranked.size());
+    for (auto &[term, count] : ranked) {
+        terms.push_back(std::move(term));
+    }
+    return true;
+}
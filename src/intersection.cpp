@@ -0,0 +1,77 @@
+#include "intersection.h"
+#include "bitmap_list.h"
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+size_t intersectBlocks(const int *a, size_t aCount, const int *b, size_t bCount, int *aMatches, int *bMatches) {
+    size_t i = 0, j = 0, count = 0;
+
+#if defined(__SSE2__)
+    // Compare four docIDs of a against four of b at once: a against every rotation of b
+    while (i + 4 <= aCount && j + 4 <= bCount) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j));
+        __m128i eq = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+        while (mask) {
+            int lane = __builtin_ctz(mask);
+            mask &= mask - 1;
+            // Matches are rare next to the comparisons, so locate the b side with a short scan
+            size_t k = j;
+            while (b[k] != a[i + lane]) k++;
+            aMatches[count] = static_cast<int>(i + lane);
+            bMatches[count] = static_cast<int>(k);
+            count++;
+        }
+
+        // Drop whichever group cannot match anything further on
+        int aLast = a[i + 3], bLast = b[j + 3];
+        if (aLast <= bLast) i += 4;
+        if (bLast <= aLast) j += 4;
+    }
+#endif
+
+    // Scalar merge for the tails
+    while (i < aCount && j < bCount) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (a[i] > b[j]) {
+            j++;
+        } else {
+            aMatches[count] = static_cast<int>(i++);
+            bMatches[count] = static_cast<int>(j++);
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t andBitmapChunks(const unsigned char *a, const unsigned char *b, uint64_t *out) {
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 2 <= BITMAP_CHUNK_WORDS; i += 2) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i * sizeof(uint64_t)));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i * sizeof(uint64_t)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_and_si128(va, vb));
+    }
+#endif
+    for (; i < BITMAP_CHUNK_WORDS; ++i) {
+        uint64_t wa, wb;
+        std::memcpy(&wa, a + i * sizeof(uint64_t), sizeof(uint64_t));
+        std::memcpy(&wb, b + i * sizeof(uint64_t), sizeof(uint64_t));
+        out[i] = wa & wb;
+    }
+
+    size_t count = 0;
+    for (int w = 0; w < BITMAP_CHUNK_WORDS; ++w) {
+        count += __builtin_popcountll(out[w]);
+    }
+    return count;
+}
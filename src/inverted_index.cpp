@@ -1,111 +1,174 @@
 #include "inverted_index.h"
 #include "compression.h"
+#include "intersection.h"
 #include <iostream>
-#include <cmath>  
-#include <cstring> 
+#include <cmath>
+#include <cstring>
+#include <climits>
 
 // --- InvertedListPointer Implementation ---
 
-InvertedListPointer::InvertedListPointer(std::ifstream *indexFile, const LexiconEntry &lexEntry)
-    : indexFile(indexFile), lexEntry(lexEntry), currentDocID(-1), valid(true),
-      lastDocID(0), bufferPos(0), currentBlockIndex(0), atBlockStart(true), termFreqScoreIndex(0) {
+InvertedListPointer::InvertedListPointer()
+    : record(nullptr), skipTable(nullptr), blockData(nullptr), termFreqScores(nullptr), docIDs(nullptr),
+      blockPostings(0), position(0), currentBlockIndex(0), currentDocID(-1), valid(false), idf(0), encoding(LIST_ENCODING_BLOCKS),
+      blockCache(nullptr), termIndex(0) {
+}
+
+InvertedListPointer::InvertedListPointer(const unsigned char *list, const LexiconRecord *record, int *docBuffer,
+                                         BlockCache *blockCache, uint32_t termIndex)
+    : record(record), skipTable(list), blockData(nullptr), termFreqScores(nullptr), docIDs(docBuffer),
+      blockPostings(0), position(0), currentBlockIndex(0), currentDocID(-1), valid(true), idf(record ? record->IDF : 0), encoding(LIST_ENCODING_BLOCKS),
+      blockCache(blockCache), termIndex(termIndex) {
+    if (!list || !record || record->blockCount <= 0) {
+        valid = false;
+        return;
+    }
+    encoding = record->encoding;
+    if (encoding == LIST_ENCODING_BITMAP) {
+        bitmap.open(list, record->blockCount, record->docFrequency, record->length);
+        return;
+    }
+    if (encoding == LIST_ENCODING_ELIAS_FANO) {
+        eliasFano.open(list, record->blockCount, record->docFrequency, record->length);
+        return;
+    }
+    // Single-block lists are stored without a skip table
+    blockData = record->blockCount > 1 ? list + record->blockCount * sizeof(SkipEntry) : list;
+
     // Initialize by loading the first block
     loadBlock(currentBlockIndex);
 }
 
+SkipEntry InvertedListPointer::skipEntry(int blockIndex) const {
+    if (record->blockCount == 1) {
+        // No skip table: the only block spans the list up to its scores
+        SkipEntry entry;
+        entry.maxDocID = INT_MAX;  // Not known without decoding; only read for blocks past the current one
+        entry.offset = 0;
+        entry.docCount = static_cast<uint16_t>(record->docFrequency);
+        entry.docIDBytes = static_cast<uint16_t>(record->length - record->docFrequency * sizeof(float));
+        return entry;
+    }
+    // Lists start at arbitrary byte offsets, so copy instead of casting
+    SkipEntry entry;
+    std::memcpy(&entry, skipTable + blockIndex * sizeof(SkipEntry), sizeof(SkipEntry));
+    return entry;
+}
+
 void InvertedListPointer::loadBlock(int blockIndex) {
-    if (blockIndex >= lexEntry.blockCount) {
+    if (blockIndex >= record->blockCount) {
         valid = false;
         return;
     }
 
     currentBlockIndex = blockIndex;
-    bufferPos = 0;
-    compressedData.clear();
-    termFreqScores.clear();
-
-    // Get the number of postings in this block
-    int postingsInBlock = lexEntry.blockDocCounts[blockIndex];
-    size_t compressedDocIDsSize = lexEntry.blockCompressedDocIDLengths[blockIndex];
-
-    // Read compressed docIDs
-    size_t blockOffset = lexEntry.blockOffsets[blockIndex];
-    indexFile->seekg(blockOffset, std::ios::beg);
-
-    compressedData.resize(compressedDocIDsSize);
-    indexFile->read(reinterpret_cast<char*>(compressedData.data()), compressedDocIDsSize);
-
-    // Read term frequency scores
-    termFreqScores.resize(postingsInBlock);
-    indexFile->read(reinterpret_cast<char*>(termFreqScores.data()), postingsInBlock * sizeof(float));
-
-    // Reset bufferPos for reading docIDs
-    bufferPos = 0;
-    atBlockStart = true;
-    lastDocID = 0;
+    SkipEntry skip = skipEntry(blockIndex);
+    blockPostings = skip.docCount;
+    const unsigned char *compressed = blockData + skip.offset;
+    termFreqScores = compressed + skip.docIDBytes;
+
+    BlockCacheKey key = {termIndex, static_cast<uint32_t>(blockIndex)};
+    if (!blockCache || !blockCache->lookup(key, [this](const CachedBlock &block) {
+            std::memcpy(docIDs, block.docIDs, block.count * sizeof(int));
+        })) {
+        // Decode the whole block: first docID is absolute, the rest are gaps
+        size_t pos = 0;
+        int docID = 0;
+        for (int i = 0; i < blockPostings; ++i) {
+            docID += varbyteDecodeNumber(compressed, pos);
+            docIDs[i] = docID;
+        }
+        if (blockCache) {
+            blockCache->insert(key, [this](CachedBlock &block) {
+                block.count = blockPostings;
+                std::memcpy(block.docIDs, docIDs, blockPostings * sizeof(int));
+            });
+        }
+    }
 
-    // Reset termFreqScoreIndex
-    termFreqScoreIndex = 0;
+    // Positioned before the first posting of the block
+    position = -1;
 }
 
 bool InvertedListPointer::next() {
     if (!valid) return false;
+    if (encoding == LIST_ENCODING_BITMAP) {
+        valid = bitmap.next();
+        currentDocID = bitmap.docID();
+        return valid;
+    }
+    if (encoding == LIST_ENCODING_ELIAS_FANO) {
+        valid = eliasFano.next();
+        currentDocID = eliasFano.docID();
+        return valid;
+    }
 
-    while (true) {
-        if (termFreqScoreIndex >= termFreqScores.size()) {
-            // End of current block
-            currentBlockIndex++;
-            if (currentBlockIndex >= lexEntry.blockCount) {
-                valid = false;
-                return false;
-            } else {
-                loadBlock(currentBlockIndex);
-                continue;
-            }
-        }
-
-        int docID;
-        if (atBlockStart) {
-            // First docID in block is stored as absolute value
-            docID = varbyteDecodeNumber(compressedData, bufferPos);
-            atBlockStart = false;
-        } else {
-            // Decompress next docID gap
-            int gap = varbyteDecodeNumber(compressedData, bufferPos);
-            docID = lastDocID + gap;
+    if (++position >= blockPostings) {
+        // End of current block
+        if (currentBlockIndex + 1 >= record->blockCount) {
+            valid = false;
+            return false;
         }
-        lastDocID = docID;
-        currentDocID = docID;
-
-        // Get term frequency score
-        termFreqScoreValue = termFreqScores[termFreqScoreIndex];
-        termFreqScoreIndex++;
+        loadBlock(currentBlockIndex + 1);
+        position = 0;
+    }
+    currentDocID = docIDs[position];
+    return true;
+}
 
-        // Successfully read posting
-        return true;
+bool InvertedListPointer::nextBlock() {
+    if (!valid) return false;
+    if (currentBlockIndex + 1 >= record->blockCount) {
+        valid = false;
+        return false;
     }
+    loadBlock(currentBlockIndex + 1);
+    seekInBlock(0);
+    return true;
 }
 
 bool InvertedListPointer::nextGEQ(int docID) {
     if (!valid) return false;
-
-    // Skip blocks where blockMaxDocID < docID
-    while (currentBlockIndex < lexEntry.blockCount && lexEntry.blockMaxDocIDs[currentBlockIndex] < docID) {
-        currentBlockIndex++;
-        if (currentBlockIndex >= lexEntry.blockCount) {
+    if (encoding == LIST_ENCODING_BITMAP) {
+        valid = bitmap.nextGEQ(docID);
+        currentDocID = bitmap.docID();
+        return valid;
+    }
+    if (encoding == LIST_ENCODING_ELIAS_FANO) {
+        valid = eliasFano.nextGEQ(docID);
+        currentDocID = eliasFano.docID();
+        return valid;
+    }
+    if (position >= 0 && currentDocID >= docID) return true;
+
+    // Target past this block (its last docID is decoded already): gallop over the skip table,
+    // decoding only the block we land in
+    if (docIDs[blockPostings - 1] < docID) {
+        int low = currentBlockIndex, step = 1, high = currentBlockIndex + 1;
+        while (high < record->blockCount && skipEntry(high).maxDocID < docID) {
+            low = high;
+            step <<= 1;
+            high = low + step;
+        }
+        if (high > record->blockCount) high = record->blockCount;
+        while (low + 1 < high) {
+            int mid = low + (high - low) / 2;
+            if (skipEntry(mid).maxDocID < docID) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        if (high >= record->blockCount) {
             valid = false;
             return false;
         }
-        loadBlock(currentBlockIndex);
+        loadBlock(high);
     }
 
-    // Now, iterate through postings in the block until we find docID >= target docID
-    while (valid && currentDocID < docID) {
-        if (!next()) {
-            return false;
-        }
-    }
-    return valid;
+    // The block's last docID is >= docID, so the search always lands inside it
+    seekInBlock(gallopGEQ(docIDs, position + 1, blockPostings, docID));
+    return true;
 }
 
 int InvertedListPointer::getDocID() const {
@@ -113,11 +176,25 @@ int InvertedListPointer::getDocID() const {
 }
 
 float InvertedListPointer::getTFS() const {
-    return termFreqScoreValue;
+    if (encoding == LIST_ENCODING_BITMAP) return bitmap.score();
+    if (encoding == LIST_ENCODING_ELIAS_FANO) return eliasFano.score();
+    float score;
+    std::memcpy(&score, termFreqScores + position * sizeof(float), sizeof(float));
+    return score;
+}
+
+float InvertedListPointer::blockScore(int pos) const {
+    float score;
+    std::memcpy(&score, termFreqScores + pos * sizeof(float), sizeof(float));
+    return score;
 }
 
 float InvertedListPointer::getIDF() const {
-    return lexEntry.IDF;
+    return idf;
+}
+
+int InvertedListPointer::getDocFrequency() const {
+    return record ? record->docFrequency : 0;
 }
 
 bool InvertedListPointer::isValid() const {
@@ -131,102 +208,41 @@ void InvertedListPointer::close() {
 // --- InvertedIndex Implementation ---
 
 InvertedIndex::InvertedIndex(const std::string &indexFilename, const std::string &lexiconFilename) {
-    // Load the lexicon from lexiconFilename
-    loadLexicon(lexiconFilename);
+    // Map the lexicon; records are used in place
+    lexicon.open(lexiconFilename);
 
-    // Open index file
-    indexFile.open(indexFilename, std::ios::binary);
-    if (!indexFile.is_open()) {
+    // Map the index file; cursors decode blocks straight from the mapping
+    if (!indexFile.open(indexFilename)) {
         std::cerr << "Error opening index file: " << indexFilename << std::endl;
         return;
     }
 }
 
-void InvertedIndex::loadLexicon(const std::string &lexiconFilename) {
-    std::ifstream lexiconFile(lexiconFilename, std::ios::binary);
-    if (!lexiconFile.is_open()) {
-        std::cerr << "Error opening lexicon file: " << lexiconFilename << std::endl;
-        return;
-    }
-
-    const int64_t documentLen = 8841823;
-
-    while (lexiconFile.peek() != EOF) {
-        uint16_t termLength;
-        lexiconFile.read(reinterpret_cast<char*>(&termLength), sizeof(termLength));
-        if (!lexiconFile) break; 
-
-        std::vector<char> termBuffer(termLength);
-        lexiconFile.read(termBuffer.data(), termLength);
-        if (!lexiconFile) break; 
-
-        std::string term(termBuffer.begin(), termBuffer.end());
-
-        LexiconEntry entry;
-        lexiconFile.read(reinterpret_cast<char*>(&entry.offset), sizeof(entry.offset));
-        lexiconFile.read(reinterpret_cast<char*>(&entry.length), sizeof(entry.length));
-        lexiconFile.read(reinterpret_cast<char*>(&entry.docFrequency), sizeof(entry.docFrequency));
-        lexiconFile.read(reinterpret_cast<char*>(&entry.blockCount), sizeof(entry.blockCount));
-
-        if (entry.blockCount > 0) {
-            // Read blockMaxDocIDs
-            entry.blockMaxDocIDs.resize(entry.blockCount);
-            for (int i = 0; i < entry.blockCount; ++i) {
-                lexiconFile.read(reinterpret_cast<char*>(&entry.blockMaxDocIDs[i]), sizeof(entry.blockMaxDocIDs[i]));
-            }
-
-            // Read blockOffsets
-            entry.blockOffsets.resize(entry.blockCount);
-            for (int i = 0; i < entry.blockCount; ++i) {
-                lexiconFile.read(reinterpret_cast<char*>(&entry.blockOffsets[i]), sizeof(entry.blockOffsets[i]));
-            }
-
-            // Read blockCompressedDocIDLengths
-            entry.blockCompressedDocIDLengths.resize(entry.blockCount);
-            for (int i = 0; i < entry.blockCount; ++i) {
-                lexiconFile.read(reinterpret_cast<char*>(&entry.blockCompressedDocIDLengths[i]), sizeof(size_t));
-            }
-
-            // Read blockDocCounts
-            entry.blockDocCounts.resize(entry.blockCount);
-            for (int i = 0; i < entry.blockCount; ++i) {
-                lexiconFile.read(reinterpret_cast<char*>(&entry.blockDocCounts[i]), sizeof(entry.blockDocCounts[i]));
-            }
-        }
-
-        // Compute IDF
-        entry.IDF = std::log((documentLen - entry.docFrequency + 0.5) / (entry.docFrequency + 0.5));
-
-        lexicon[term] = entry;
-    }
-    lexiconFile.close();
+size_t InvertedIndex::prefetchList(uint32_t termIndex) const {
+    const LexiconRecord &record = lexicon.record(termIndex);
+    return indexFile.prefetch(static_cast<size_t>(record.offset), static_cast<size_t>(record.length));
 }
 
-bool InvertedIndex::openList(const std::string &term) {
-    return lexicon.find(term) != lexicon.end();
+int64_t InvertedIndex::findTerm(std::string_view term) const {
+    return lexicon.find(term);
 }
 
-InvertedListPointer InvertedIndex::getListPointer(const std::string &term) {
-    auto it = lexicon.find(term);
-    if (it != lexicon.end()) {
-        return InvertedListPointer(&indexFile, it->second);
-    } else {
-        // Handle term not found
-        std::cerr << "Term not found in lexicon: " << term << std::endl;
-        // Return an invalid InvertedListPointer
-        LexiconEntry emptyEntry;
-        return InvertedListPointer(nullptr, emptyEntry);
-    }
+const LexiconRecord &InvertedIndex::getRecord(uint32_t termIndex) const {
+    return lexicon.record(termIndex);
 }
 
-void InvertedIndex::closeList(const std::string &term) {
-    // No action needed as we're not keeping any state per term
+InvertedListPointer InvertedIndex::openList(uint32_t termIndex, int *docBuffer) const {
+    const LexiconRecord &record = lexicon.record(termIndex);
+    if (!indexFile.isOpen() || record.offset + record.length > static_cast<int64_t>(indexFile.size())) {
+        return InvertedListPointer();
+    }
+    return InvertedListPointer(indexFile.data() + record.offset, &record, docBuffer, blockCache, termIndex);
 }
 
-int InvertedIndex::getDocFrequency(const std::string &term) {
-    auto it = lexicon.find(term);
-    if (it != lexicon.end()) {
-        return it->second.docFrequency;
+int InvertedIndex::getDocFrequency(std::string_view term) const {
+    int64_t index = lexicon.find(term);
+    if (index >= 0) {
+        return lexicon.record(static_cast<uint32_t>(index)).docFrequency;
     } else {
         return 0;
     }
@@ -0,0 +1,215 @@
+#include "lexicon.h"
+#include "compression.h"
+#include "file_write_buffer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#define LEXICON_WRITE_CHUNK 40000000 // Write 40MB at a time
+
+// Pad the written size up to the next multiple of 8
+static void writePadding(WriteFileBuffer &output, uint64_t &written) {
+    static const char zeros[8] = {0};
+    size_t padding = (8 - written % 8) % 8;
+    output.write(zeros, padding);
+    written += padding;
+}
+
+static size_t commonPrefixLength(std::string_view a, std::string_view b) {
+    size_t n = std::min(a.size(), b.size());
+    size_t i = 0;
+    while (i < n && a[i] == b[i]) i++;
+    return i;
+}
+
+std::string perfectHashFilename(const std::string &lexiconFilename) {
+    std::string base = lexiconFilename;
+    if (base.size() > 4 && base.compare(base.size() - 4, 4, ".bin") == 0) {
+        base.resize(base.size() - 4);
+    }
+    return base + "_mph.bin";
+}
+
+// --- Lexicon writer ---
+
+void writeLexicon(const std::string &filename, std::vector<std::pair<std::string, LexiconEntry>> &lexicon, int64_t totalDocs) {
+    auto byTerm = [](const auto &a, const auto &b) { return a.first < b.first; };
+    if (!std::is_sorted(lexicon.begin(), lexicon.end(), byTerm)) {
+        std::sort(lexicon.begin(), lexicon.end(), byTerm);
+    }
+
+    LexiconHeader header = {};
+    header.magic = LEXICON_MAGIC;
+    header.bucketSize = LEXICON_BUCKET_SIZE;
+    header.termCount = static_cast<uint32_t>(lexicon.size());
+    header.bucketCount = (header.termCount + LEXICON_BUCKET_SIZE - 1) / LEXICON_BUCKET_SIZE;
+
+    // Front-code the terms and collect fixed-width records
+    std::vector<uint32_t> bucketIndex;
+    std::vector<unsigned char> termBlob;
+    std::vector<LexiconRecord> records;
+    bucketIndex.reserve(header.bucketCount);
+    records.reserve(lexicon.size());
+    std::vector<unsigned char> encodedNumber;
+    for (size_t i = 0; i < lexicon.size(); ++i) {
+        const std::string &term = lexicon[i].first;
+        const LexiconEntry &entry = lexicon[i].second;
+
+        size_t prefix = 0;
+        if (i % LEXICON_BUCKET_SIZE == 0) {
+            bucketIndex.push_back(static_cast<uint32_t>(termBlob.size()));
+        } else {
+            prefix = commonPrefixLength(lexicon[i - 1].first, term);
+        }
+        varbyteEncode(static_cast<int>(prefix), encodedNumber);
+        termBlob.insert(termBlob.end(), encodedNumber.begin(), encodedNumber.end());
+        varbyteEncode(static_cast<int>(term.size() - prefix), encodedNumber);
+        termBlob.insert(termBlob.end(), encodedNumber.begin(), encodedNumber.end());
+        termBlob.insert(termBlob.end(), term.begin() + prefix, term.end());
+
+        LexiconRecord record = {};
+        record.offset = entry.offset;
+        record.length = entry.length;
+        record.docFrequency = entry.docFrequency;
+        record.blockCount = entry.blockCount;
+        record.IDF = bm25IDF(totalDocs, entry.docFrequency);
+        record.encoding = entry.encoding;
+        records.push_back(record);
+    }
+
+    uint64_t written = sizeof(LexiconHeader);
+    header.bucketIndexOffset = written;
+    written += bucketIndex.size() * sizeof(uint32_t);
+    written += (8 - written % 8) % 8;
+    header.termBlobOffset = written;
+    written += termBlob.size();
+    written += (8 - written % 8) % 8;
+    header.recordOffset = written;
+
+    WriteFileBuffer output(filename, LEXICON_WRITE_CHUNK);
+    written = 0;
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    written += sizeof(header);
+    output.write(reinterpret_cast<const char *>(bucketIndex.data()), bucketIndex.size() * sizeof(uint32_t));
+    written += bucketIndex.size() * sizeof(uint32_t);
+    writePadding(output, written);
+    output.write(reinterpret_cast<const char *>(termBlob.data()), termBlob.size());
+    written += termBlob.size();
+    writePadding(output, written);
+    output.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(LexiconRecord));
+
+    std::cout << "Lexicon written to " << filename << " with " << header.termCount << " terms." << std::endl;
+}
+
+// --- Lexicon reader ---
+
+bool Lexicon::open(const std::string &filename) {
+    header = nullptr;
+    if (!file.open(filename)) {
+        std::cerr << "Error opening lexicon file: " << filename << std::endl;
+        return false;
+    }
+    const unsigned char *base = file.data();
+    const LexiconHeader *fileHeader = reinterpret_cast<const LexiconHeader *>(base);
+    if (file.size() < sizeof(LexiconHeader) || fileHeader->magic != LEXICON_MAGIC) {
+        std::cerr << "Not a lexicon file (rebuild the index): " << filename << std::endl;
+        file.close();
+        return false;
+    }
+    if (fileHeader->recordOffset + fileHeader->termCount * sizeof(LexiconRecord) > file.size()) {
+        std::cerr << "Truncated lexicon file: " << filename << std::endl;
+        file.close();
+        return false;
+    }
+
+    header = fileHeader;
+    bucketIndex = reinterpret_cast<const uint32_t *>(base + header->bucketIndexOffset);
+    termBlob = base + header->termBlobOffset;
+    records = reinterpret_cast<const LexiconRecord *>(base + header->recordOffset);
+
+    // Optional: older builds only have the sorted lexicon
+    if (termHash.open(perfectHashFilename(filename)) && termHash.keyCount() != header->termCount) {
+        // A hash built for a different vocabulary would return wrong records
+        std::cerr << "Ignoring perfect hash that does not match " << filename << std::endl;
+        termHash.close();
+    }
+    return true;
+}
+
+std::string_view Lexicon::firstTerm(uint32_t bucket) const {
+    size_t pos = bucketIndex[bucket];
+    varbyteDecodeNumber(termBlob, pos); // Shared prefix, always 0 for the first term
+    size_t length = varbyteDecodeNumber(termBlob, pos);
+    return std::string_view(reinterpret_cast<const char *>(termBlob + pos), length);
+}
+
+int64_t Lexicon::find(std::string_view term) const {
+    if (termHash.isOpen()) {
+        return termHash.find(term);
+    }
+    return findSorted(term);
+}
+
+int64_t Lexicon::findSorted(std::string_view term) const {
+    if (!header || header->termCount == 0) return -1;
+
+    // Last bucket whose first term is <= term
+    uint32_t lo = 0, hi = header->bucketCount;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (firstTerm(mid) <= term) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) return -1;
+    uint32_t bucket = lo - 1;
+
+    // Scan the bucket without rebuilding terms: track how much of the query
+    // matches the previous term and compare only the new suffix
+    uint32_t first = bucket * header->bucketSize;
+    uint32_t last = std::min(first + header->bucketSize, header->termCount);
+    size_t pos = bucketIndex[bucket];
+    size_t matched = 0;
+    for (uint32_t i = first; i < last; ++i) {
+        size_t prefix = varbyteDecodeNumber(termBlob, pos);
+        size_t suffixLength = varbyteDecodeNumber(termBlob, pos);
+        const char *suffix = reinterpret_cast<const char *>(termBlob + pos);
+        pos += suffixLength;
+
+        if (prefix > matched) {
+            continue;  // Same divergence from the query as the previous (smaller) term
+        }
+        if (prefix < matched) {
+            return -1; // Diverges earlier with a larger character: past the query
+        }
+        size_t extra = commonPrefixLength(std::string_view(suffix, suffixLength), term.substr(matched));
+        matched += extra;
+        size_t length = prefix + suffixLength;
+        if (matched == length && matched == term.size()) {
+            return i;
+        }
+        bool smaller = matched == length ||
+                       (matched < term.size() && static_cast<unsigned char>(suffix[extra]) < static_cast<unsigned char>(term[matched]));
+        if (!smaller) {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+std::string Lexicon::term(uint32_t index) const {
+    uint32_t bucket = index / header->bucketSize;
+    size_t pos = bucketIndex[bucket];
+    std::string current;
+    for (uint32_t i = bucket * header->bucketSize; i <= index; ++i) {
+        size_t prefix = varbyteDecodeNumber(termBlob, pos);
+        size_t suffixLength = varbyteDecodeNumber(termBlob, pos);
+        current.resize(prefix);
+        current.append(reinterpret_cast<const char *>(termBlob + pos), suffixLength);
+        pos += suffixLength;
+    }
+    return current;
+}
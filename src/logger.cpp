@@ -0,0 +1,237 @@
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+std::atomic<int> logThreshold{LOG_LEVEL_OFF};
+
+namespace {
+
+struct LogRecord {
+    int64_t nanoseconds;  // Steady clock; turned into wall time when written
+    uint32_t thread;
+    uint8_t level;
+    uint16_t length;
+    char text[LOG_RECORD_TEXT];
+};
+
+// Single-producer single-consumer ring: the owning thread writes at head, the drain
+// thread reads at tail
+struct LogRing {
+    LogRecord records[LOG_RING_RECORDS];
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> retired{false};  // Owning thread has exited
+    uint32_t thread = 0;
+};
+
+struct LogState {
+    std::mutex ringsMutex;  // Taken once per thread, to register its ring, and by the drain thread
+    std::vector<std::shared_ptr<LogRing>> rings;
+    uint32_t nextThread = 0;
+
+    std::ofstream file;
+    std::atomic<bool> running{false};
+    std::chrono::steady_clock::time_point steadyStart;
+    std::chrono::system_clock::time_point wallStart;
+
+    std::thread drainer;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::atomic<bool> drainWanted{false};  // A writer is waiting on a full ring
+
+    ~LogState() { stopLogging(); }
+};
+
+LogState state;
+
+// Marks the thread's ring retired when the thread exits; the drain thread frees it once empty
+struct ThreadRing {
+    std::shared_ptr<LogRing> ring;
+    ~ThreadRing() {
+        if (ring) ring->retired.store(true, std::memory_order_release);
+    }
+};
+
+thread_local ThreadRing threadRing;
+
+LogRing &ringOfThread() {
+    if (!threadRing.ring) {
+        auto ring = std::make_shared<LogRing>();
+        std::lock_guard<std::mutex> lock(state.ringsMutex);
+        ring->thread = state.nextThread++;
+        state.rings.push_back(ring);
+        threadRing.ring = std::move(ring);
+    }
+    return *threadRing.ring;
+}
+
+const char *levelName(int level) {
+    static const char *names[] = {"DEBUG", "INFO ", "WARN ", "ERROR"};
+    return level >= LOG_LEVEL_DEBUG && level < LOG_LEVEL_OFF ? names[level] : "?    ";
+}
+
+// Move every queued record out of the rings, oldest first, and write them
+void drainRings(std::vector<LogRecord> &batch, std::string &lines) {
+    std::vector<std::shared_ptr<LogRing>> rings;
+    {
+        std::lock_guard<std::mutex> lock(state.ringsMutex);
+        rings = state.rings;
+    }
+
+    batch.clear();
+    uint64_t dropped = 0;
+    for (const auto &ring : rings) {
+        bool retired = ring->retired.load(std::memory_order_acquire);
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            batch.push_back(ring->records[tail % LOG_RING_RECORDS]);
+        }
+        ring->tail.store(tail, std::memory_order_release);
+        dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+        if (retired) {
+            // Nothing more comes from an exited thread
+            std::lock_guard<std::mutex> lock(state.ringsMutex);
+            state.rings.erase(std::find(state.rings.begin(), state.rings.end(), ring));
+        }
+    }
+    if (batch.empty() && dropped == 0) {
+        return;
+    }
+    std::stable_sort(batch.begin(), batch.end(), [](const LogRecord &a, const LogRecord &b) {
+        return a.nanoseconds < b.nanoseconds;
+    });
+
+    // The date part only changes once a second
+    lines.clear();
+    std::time_t formattedSecond = -1;
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::tm local;
+    std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime_r(&now, &local));
+    char prefix[64];
+    for (const LogRecord &record : batch) {
+        auto wall = state.wallStart + std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                                          std::chrono::nanoseconds(record.nanoseconds) - state.steadyStart.time_since_epoch());
+        std::time_t second = std::chrono::system_clock::to_time_t(wall);
+        if (second != formattedSecond) {
+            localtime_r(&second, &local);
+            std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &local);
+            formattedSecond = second;
+        }
+        long microseconds = static_cast<long>(
+            std::chrono::duration_cast<std::chrono::microseconds>(wall.time_since_epoch()).count() % 1000000);
+        int prefixLength = std::snprintf(prefix, sizeof(prefix), "%s.%06ld %s [%u] ", date, microseconds,
+                                         levelName(record.level), record.thread);
+        lines.append(prefix, prefixLength);
+        lines.append(record.text, record.length);
+        lines.push_back('\n');
+    }
+    if (dropped > 0) {
+        lines += std::string(date) + " WARN  Log rings full: " + std::to_string(dropped) + " messages dropped\n";
+    }
+    state.file.write(lines.data(), lines.size());
+    state.file.flush();
+}
+
+void drainLoop() {
+    std::vector<LogRecord> batch;
+    std::string lines;
+    std::unique_lock<std::mutex> lock(state.wakeMutex);
+    while (!state.stopping) {
+        state.wake.wait_for(lock, std::chrono::milliseconds(LOG_DRAIN_MILLISECONDS),
+                            [] { return state.stopping || state.drainWanted.load(); });
+        state.drainWanted.store(false);
+        lock.unlock();
+        drainRings(batch, lines);
+        lock.lock();
+    }
+    // What was logged during the last pass
+    lock.unlock();
+    drainRings(batch, lines);
+}
+
+} // namespace
+
+bool startLogging(const std::string &filename, LogLevel level) {
+    stopLogging();
+    state.file.open(filename, std::ios::app);
+    if (!state.file.is_open()) {
+        std::cerr << "Failed to open log file: " << filename << std::endl;
+        return false;
+    }
+    state.steadyStart = std::chrono::steady_clock::now();
+    state.wallStart = std::chrono::system_clock::now();
+    state.stopping = false;
+    state.running.store(true);
+    state.drainer = std::thread(drainLoop);
+    logThreshold.store(level, std::memory_order_relaxed);
+    return true;
+}
+
+void stopLogging() {
+    if (!state.drainer.joinable()) {
+        return;
+    }
+    logThreshold.store(LOG_LEVEL_OFF, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(state.wakeMutex);
+        state.stopping = true;
+    }
+    state.wake.notify_one();
+    state.drainer.join();
+    state.running.store(false);
+    state.file.close();
+}
+
+void setLogLevel(LogLevel level) {
+    if (state.running.load()) {
+        logThreshold.store(level, std::memory_order_relaxed);
+    }
+}
+
+bool parseLogLevel(std::string_view name, LogLevel &level) {
+    static const char *names[] = {"debug", "info", "warn", "error", "off"};
+    for (int i = LOG_LEVEL_DEBUG; i <= LOG_LEVEL_OFF; ++i) {
+        if (name == names[i]) {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void logWrite(LogLevel level, std::string_view message) {
+    LogRing &ring = ringOfThread();
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    while (head - ring.tail.load(std::memory_order_acquire) == LOG_RING_RECORDS) {
+        if (level < LOG_LEVEL_WARN || !state.running.load(std::memory_order_relaxed)) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        state.drainWanted.store(true);
+        state.wake.notify_one();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    LogRecord &record = ring.records[head % LOG_RING_RECORDS];
+    record.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now().time_since_epoch()).count();
+    record.thread = ring.thread;
+    record.level = static_cast<uint8_t>(level);
+    record.length = static_cast<uint16_t>(std::min(message.size(), LOG_RECORD_TEXT));
+    std::memcpy(record.text, message.data(), record.length);
+    ring.head.store(head + 1, std::memory_order_release);
+}
@@ -0,0 +1,55 @@
+#include "mapped_file.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string &filename) {
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void *addr = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+    if (addr == MAP_FAILED) return false;
+
+    mapping = addr;
+    length = info.st_size;
+    return true;
+}
+
+size_t MappedFile::prefetch(size_t offset, size_t bytes) const {
+    if (!mapping || offset >= length) return 0;
+    bytes = std::min(bytes, length - offset);
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t start = offset & ~(pageSize - 1);
+    madvise(static_cast<char *>(mapping) + start, offset + bytes - start, MADV_WILLNEED);
+
+    const volatile unsigned char *bytesIn = static_cast<const unsigned char *>(mapping);
+    unsigned char sink = 0;
+    for (size_t page = start; page < offset + bytes; page += pageSize) {
+        sink ^= bytesIn[page];
+    }
+    (void)sink;
+    return bytes;
+}
+
+void MappedFile::close() {
+    if (mapping) {
+        munmap(mapping, length);
+        mapping = nullptr;
+        length = 0;
+    }
+}
@@ -3,6 +3,18 @@
 #include "file_write_buffer.h"
 #include "thread_pool.h"
 #include "compression.h"
+#include "lexicon.h"
+#include "posting_list.h"
+#include "bitmap_list.h"
+#include "elias_fano.h"
+#include "impact_index.h"
+#include "tier1_index.h"
+#include "champion_lists.h"
+#include "segment_manifest.h"
+#include "segment_merge.h"
+#include "tombstones.h"
+#include "doc_tables.h"
+#include "logger.h"
 #include <iostream>
 #include <fstream>
 #include <vector>
@@ -12,6 +24,7 @@
 #include <unordered_map>
 #include <map>
 #include <cstdint>
+#include <cstdlib>
 #include <functional>
 #include <filesystem>
 #include <ctime>
@@ -21,26 +34,20 @@
 
 namespace fs = std::filesystem;
 
-// Number of postings per block
-const int BLOCK_SIZE = 128;
 const int FILES_TO_MERGE = 8;
 #define MAX_RECORDS 100000000 // Max records in memory
 #define THREAD_CNT 8
 #define CHUNK_SIZE 40000000   // Read 40MB at a time
 #define PARTITION_SIZE 26
 
-std::ofstream logFile("../logs/merge_temp_file.log", std::ios::app);
-
-void logMessage(const std::string &message)
-{
-    if (!logFile.is_open())
-    {
-        std::cerr << "Failed to open log file!" << std::endl;
-        return;
-    }
-    std::time_t currentTime = std::time(nullptr);
-    logFile << std::asctime(std::localtime(&currentTime)) << message << std::endl;
-}
+// Set by --elias-fano: store lists that are not dense enough for bitmaps as partitioned Elias-Fano
+bool eliasFanoLists = false;
+// Set by --impact: also build the impact-ordered index for score-at-a-time queries
+bool writeImpactIndex = false;
+// Set by --tier1 N: also build a tier-1 index keeping each term's N best postings (0: none)
+uint32_t tier1PostingsPerTerm = 0;
+// Set by --segment DIR: read the temp runs from DIR/intermediate and write the index into DIR
+std::string dataDirectory = SEGMENT_BASE_DIRECTORY;
 
 void mergeFiles(const std::vector<std::string> &fileNames, const std::string &outputFile)
 {
@@ -106,88 +113,44 @@ void mergeFiles(const std::vector<std::string> &fileNames, const std::string &ou
     }
 }
 
-// Updated function to handle block-level indexing
+// Encode a posting list (skip table + blocks, bitmap chunks for dense lists, or Elias-Fano
+// partitions when enabled); offset is left for the caller
+LexiconEntry encodePostings(const std::vector<std::pair<int, float>> &postingsList, std::vector<unsigned char> &encodedList)
+{
+    LexiconEntry entry;
+    entry.offset = 0;
+    entry.docFrequency = postingsList.size();
+    if (preferBitmapEncoding(postingsList))
+    {
+        entry.encoding = LIST_ENCODING_BITMAP;
+        entry.blockCount = encodeBitmapList(postingsList, encodedList);
+    }
+    else if (eliasFanoLists)
+    {
+        entry.encoding = LIST_ENCODING_ELIAS_FANO;
+        entry.blockCount = encodeEliasFanoList(postingsList, encodedList);
+    }
+    else
+    {
+        entry.encoding = LIST_ENCODING_BLOCKS;
+        entry.blockCount = encodePostingList(postingsList, encodedList);
+    }
+    entry.length = encodedList.size();
+    entry.IDF = 0; // Computed when the lexicon is written
+    return entry;
+}
+
+// Encode the finished posting list and record its lexicon entry
 void saveAndClearCurPostingsList(std::vector<std::pair<int, float>> &postingsList, int64_t &offset,
                                  WriteFileBuffer &indexFile, std::vector<std::pair<std::string, LexiconEntry>> &lexicon,
                                  std::string &currentTerm, std::string &term)
 {
-    // Process postingsList for currentTerm
-    int df = postingsList.size();
-
-    // Calculate block count
-    int blockCount = (df + BLOCK_SIZE - 1) / BLOCK_SIZE; // ceil(df / BLOCK_SIZE)
+    static thread_local std::vector<unsigned char> encodedList;
 
-    LexiconEntry entry;
+    LexiconEntry entry = encodePostings(postingsList, encodedList);
     entry.offset = offset;
-    entry.length = 0; // Will be updated after writing all blocks
-    entry.docFrequency = df;
-    entry.blockCount = blockCount;
-    entry.blockMaxDocIDs.reserve(blockCount);
-    entry.blockOffsets.reserve(blockCount);
-    entry.blockCompressedDocIDLengths.reserve(blockCount);
-    entry.blockDocCounts.reserve(blockCount);
-
-    int currentBlockIndex = 0;
-    int64_t currentOffset = offset; // Keep track of the current offset
-
-    size_t postingsProcessed = 0;
-
-    while (postingsProcessed < postingsList.size())
-    {
-        size_t blockStart = postingsProcessed;
-        size_t blockEnd = std::min(postingsProcessed + BLOCK_SIZE, postingsList.size());
-        size_t blockSize = blockEnd - blockStart;
-
-        // Prepare data for this block
-        std::vector<unsigned char> blockCompressedData;
-        std::vector<float> blockTermFScores(blockSize);
-
-        // For the first docID in the block, store as absolute value
-        int firstDocID = postingsList[blockStart].first;
-        std::vector<unsigned char> encodedNumber;
-        varbyteEncode(firstDocID, encodedNumber);
-        blockCompressedData.insert(blockCompressedData.end(), encodedNumber.begin(), encodedNumber.end());
-        blockTermFScores[0] = postingsList[blockStart].second;
-        int lastDocID = firstDocID;
-
-        // For the rest, store docID gaps
-        for (size_t i = 1; i < blockSize; ++i)
-        {
-            int docID = postingsList[blockStart + i].first;
-            int gap = docID - lastDocID;
-            varbyteEncode(gap, encodedNumber);
-            blockCompressedData.insert(blockCompressedData.end(), encodedNumber.begin(), encodedNumber.end());
-            lastDocID = docID;
-
-            blockTermFScores[i] = postingsList[blockStart + i].second;
-        }
-
-        // Record blockMaxDocID, blockOffset, compressedDocIDLength, and blockDocCount
-        int blockMaxDocID = postingsList[blockEnd - 1].first;
-        entry.blockMaxDocIDs.push_back(blockMaxDocID);
-        entry.blockOffsets.push_back(currentOffset);
-        entry.blockCompressedDocIDLengths.push_back(blockCompressedData.size());
-        entry.blockDocCounts.push_back(static_cast<int32_t>(blockSize));
-
-        // Write block data to index file
-
-        // First, write the compressed docIDs
-        indexFile.write(reinterpret_cast<char *>(blockCompressedData.data()), blockCompressedData.size());
-        currentOffset += blockCompressedData.size();
-
-        // Then, write the term frequency scores
-        size_t termFreqScoreSize = blockTermFScores.size() * sizeof(float);
-        indexFile.write(reinterpret_cast<char *>(blockTermFScores.data()), termFreqScoreSize);
-        currentOffset += termFreqScoreSize;
-
-        // Update postingsProcessed
-        postingsProcessed += blockSize;
-        currentBlockIndex++;
-    }
-
-    // Update total length
-    entry.length = currentOffset - offset;
-    offset = currentOffset;
+    indexFile.write(reinterpret_cast<char *>(encodedList.data()), encodedList.size());
+    offset += encodedList.size();
 
     // Add lexicon entry
     lexicon.emplace_back(currentTerm, entry);
@@ -199,7 +162,7 @@ void saveAndClearCurPostingsList(std::vector<std::pair<int, float>> &postingsLis
 
 std::string getIndexFileName(const std::string &startTerm)
 {
-    return "../data/index/index_" + startTerm + ".bin";
+    return dataDirectory + "/index/index_" + startTerm + ".bin";
 }
 
 // Updated to handle block-level metadata
@@ -217,7 +180,7 @@ void mergeLastTempFileWithPartition(std::vector<std::string> inputFiles,
                                CHUNK_SIZE / THREAD_CNT / numFiles);
         if (!tempFiles[i].isValid())
         {
-            logMessage("Error opening temp file for merging.");
+            LOG_ERROR("Error opening temp file for merging.");
             return;
         }
     }
@@ -296,10 +259,10 @@ void mergeLastTempFileWithPartition(std::vector<std::string> inputFiles,
     }
     std::cout << "Total write for " << getIndexFileName(endTerm) << " is " << offset << std::endl;
     // Log completion
-    logMessage("Merging completed for partition.");
+    LOG_INFO("Merging completed for partition.");
 }
 
-// Updated function to adjust offsets for block-level data
+// Concatenate the partition index files and rebase the lexicon offsets
 void mergeBinaryFiles(const std::vector<std::string> &filenames,
                       std::vector<std::vector<std::pair<std::string, LexiconEntry>>> &lexicons,
                       const std::string &outputFilename,
@@ -336,15 +299,9 @@ void mergeBinaryFiles(const std::vector<std::string> &filenames,
             std::string term = pair.first;
             LexiconEntry lexicon = pair.second;
 
-            // Adjust lexicon.offset to cumulative offset
+            // Adjust lexicon.offset to cumulative offset; block offsets are relative to the list
             lexicon.offset += offset;
 
-            // Adjust blockOffsets
-            for (size_t j = 0; j < lexicon.blockOffsets.size(); ++j)
-            {
-                lexicon.blockOffsets[j] += offset;
-            }
-
             // Add to outputLexicon
             outputLexicon.emplace_back(term, lexicon);
         }
@@ -374,17 +331,17 @@ void mergeLastTempFile(std::vector<std::string> inputFiles,
     termsVec.push_back(""); // Add the end term
     std::vector<std::vector<std::pair<std::string, LexiconEntry>>> orderedLexicons(termsVec.size(),
                                                                                    std::vector<std::pair<std::string, LexiconEntry>>());
+    std::vector<std::function<void()>> tasks;
     for (size_t i = 0; i < termsVec.size(); i++)
     {
         auto start = i == 0 ? "" : termsVec[i - 1];
         auto end = termsVec[i];
-        auto task = [inputFiles, start, end, i, &orderedLexicons]
-        {
-            mergeLastTempFileWithPartition(inputFiles, start, end, orderedLexicons[i]);
-        };
-        threadPool.enqueue(task);
+        tasks.push_back([inputFiles, start, end, i, &orderedLexicons]
+                        { mergeLastTempFileWithPartition(inputFiles, start, end, orderedLexicons[i]); });
     }
-    threadPool.waitAll();
+    TaskGroup partitions;
+    threadPool.submitBatch(partitions, tasks);
+    partitions.wait();
     uint32_t cnt = 0;
     lexicon.clear();
     int64_t offset = 0;
@@ -393,76 +350,113 @@ void mergeLastTempFile(std::vector<std::string> inputFiles,
     {
         fileNames.push_back(getIndexFileName(termsVec[i]));
     }
-    mergeBinaryFiles(fileNames, orderedLexicons, "../data/index.bin", lexicon);
+    mergeBinaryFiles(fileNames, orderedLexicons, segmentFile(dataDirectory, "index.bin"), lexicon);
 }
 
-// Updated function to write block-level metadata
-void writeLexiconToFile(const std::vector<std::pair<std::string, LexiconEntry>> &lexicon)
+// Write the sorted, front-coded lexicon used in place by the query processor
+void writeLexiconToFile(std::vector<std::pair<std::string, LexiconEntry>> &lexicon, const std::string &directory)
 {
-    WriteFileBuffer lexiconFile("../data/lexicon.bin", CHUNK_SIZE);
-    uint32_t cnt = 0;
+    std::cout << "Writing lexicon with " << lexicon.size() << " terms." << std::endl;
+    std::string lexiconFilename = segmentFile(directory, "lexicon.bin");
+    writeLexicon(lexiconFilename, lexicon, IDF_TOTAL_DOCUMENTS);
+
+    // Minimal perfect hash over the (now sorted) vocabulary for single-probe term lookup
+    std::vector<std::string_view> terms;
+    terms.reserve(lexicon.size());
+    size_t bitmapLists = 0;
     for (const auto &[term, entry] : lexicon)
     {
-        if (cnt++ % 10000 == 0)
-        {
-            std::cout << "Lexicon: " << term << " Length: " << entry.length << std::endl;
-        }
-        // Write term length and term
-        uint16_t termLength = static_cast<uint16_t>(term.length());
-        lexiconFile.write(reinterpret_cast<const char *>(&termLength), sizeof(termLength));
-        lexiconFile.write(term.c_str(), termLength);
+        terms.push_back(term);
+        bitmapLists += entry.encoding == LIST_ENCODING_BITMAP;
+    }
+    std::cout << bitmapLists << " dense lists stored as bitmaps." << std::endl;
+    buildPerfectHash(terms, perfectHashFilename(lexiconFilename));
+}
 
-        // Write LexiconEntry data
-        lexiconFile.write(reinterpret_cast<const char *>(&entry.offset), sizeof(entry.offset));
-        lexiconFile.write(reinterpret_cast<const char *>(&entry.length), sizeof(entry.length));
-        lexiconFile.write(reinterpret_cast<const char *>(&entry.docFrequency), sizeof(entry.docFrequency));
+// Build the structures derived from a segment's finished index and lexicon
+void buildDerivedIndexes(const std::string &directory)
+{
+    std::string indexFilename = segmentFile(directory, "index.bin");
+    std::string lexiconFilename = segmentFile(directory, "lexicon.bin");
+    buildChampionLists(indexFilename, lexiconFilename, championListsFilename(lexiconFilename));
 
-        // Write blockCount
-        lexiconFile.write(reinterpret_cast<const char *>(&entry.blockCount), sizeof(entry.blockCount));
+    if (writeImpactIndex)
+    {
+        buildImpactIndex(indexFilename, lexiconFilename, impactIndexFilename(indexFilename));
+    }
+    if (tier1PostingsPerTerm > 0)
+    {
+        buildTier1Index(indexFilename, lexiconFilename, tier1IndexFilename(indexFilename), tier1PostingsPerTerm);
+    }
+}
 
-        if (entry.blockCount > 0)
+#include <chrono>
+
+int main(int argc, char *argv[])
+{
+    // --segment DIR builds the index of DIR (parsed with parser_and_indexer_mt --output DIR) and
+    // appends it to the segment manifest; --compact merges segments by the tiered policy.
+    // --publish DIR builds DIR and makes it the whole index, for deploying a rebuild to a running server.
+    // --log-level debug|info|warn|error|off sets what goes to the log (default info).
+    startLogging("../logs/merge_temp_file.log");
+    bool compact = false, publish = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--elias-fano")
         {
-            // Write blockMaxDocIDs
-            for (int i = 0; i < entry.blockCount; ++i)
-            {
-                int32_t blockMaxDocID = entry.blockMaxDocIDs[i];
-                lexiconFile.write(reinterpret_cast<const char *>(&blockMaxDocID), sizeof(blockMaxDocID));
-            }
-            // Write blockOffsets
-            for (int i = 0; i < entry.blockCount; ++i)
-            {
-                int64_t blockOffset = entry.blockOffsets[i];
-                lexiconFile.write(reinterpret_cast<const char *>(&blockOffset), sizeof(blockOffset));
-            }
-            // Write blockCompressedDocIDLengths
-            for (int i = 0; i < entry.blockCount; ++i)
-            {
-                size_t compressedLength = entry.blockCompressedDocIDLengths[i];
-                lexiconFile.write(reinterpret_cast<const char *>(&compressedLength), sizeof(size_t));
-            }
-            // Write blockDocCounts
-            for (int i = 0; i < entry.blockCount; ++i)
+            eliasFanoLists = true;
+        }
+        else if (std::string(argv[i]) == "--impact")
+        {
+            writeImpactIndex = true;
+        }
+        else if (std::string(argv[i]) == "--tier1" && i + 1 < argc)
+        {
+            tier1PostingsPerTerm = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::string(argv[i]) == "--segment" && i + 1 < argc)
+        {
+            dataDirectory = argv[++i];
+        }
+        else if (std::string(argv[i]) == "--publish" && i + 1 < argc)
+        {
+            dataDirectory = argv[++i];
+            publish = true;
+        }
+        else if (std::string(argv[i]) == "--compact")
+        {
+            compact = true;
+        }
+        else if (std::string(argv[i]) == "--log-level" && i + 1 < argc)
+        {
+            LogLevel level;
+            if (parseLogLevel(argv[++i], level))
             {
-                int32_t docCount = entry.blockDocCounts[i];
-                lexiconFile.write(reinterpret_cast<const char *>(&docCount), sizeof(docCount));
+                setLogLevel(level);
             }
         }
     }
 
-    logMessage("Lexicon written to file.");
-}
-
-#include <chrono>
-
-int main()
-{
     auto startTime = std::chrono::high_resolution_clock::now();
+    if (compact)
+    {
+        int merges = compactSegments();
+        if (merges < 0)
+        {
+            return 1;
+        }
+        std::cout << "Segment merges: " << merges << std::endl;
+        auto endTime = std::chrono::high_resolution_clock::now();
+        std::cout << "Time elapsed: " << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << " ms" << std::endl;
+        return 0;
+    }
+
     std::vector<std::string> filesToMerge;
     // Read the number of temp files generated
     int numTempFiles = 0;
     while (true)
     {
-        std::string tempFileName = "../data/intermediate/temp" + std::to_string(numTempFiles) + ".bin";
+        std::string tempFileName = dataDirectory + "/intermediate/temp" + std::to_string(numTempFiles) + ".bin";
         if (!fs::exists(tempFileName))
         {
             break;
@@ -476,20 +470,23 @@ int main()
         std::cerr << "No temp files found for merging." << std::endl;
         return 1;
     }
+    fs::create_directories(dataDirectory + "/index");
 
     ThreadPool pool(THREAD_CNT);
     int fileCounter = 0;
-    while (filesToMerge.size() > 1)
+    // A single run (a small segment) goes straight to the last merge
+    while (!filesToMerge.empty())
     {
         int outputCnt = std::ceil(static_cast<float>(filesToMerge.size()) / FILES_TO_MERGE);
         if (outputCnt > 1)
         {
             std::vector<std::string> outputFilenames(outputCnt);
+            TaskGroup merges;
 
             for (int i = 0; i < outputCnt; i++)
             {
                 // Generate the output filename
-                std::string outputFileName = "../data/intermediate/merging" + std::to_string(fileCounter++) + ".bin";
+                std::string outputFileName = dataDirectory + "/intermediate/merging" + std::to_string(fileCounter++) + ".bin";
                 outputFilenames[i] = outputFileName;
 
                 // Gather the files for this batch
@@ -502,11 +499,11 @@ int main()
                 std::cout << "Enqueuing merge task for files: size: " << batchFiles.size();
                 std::cout << " -> Output file: " << outputFileName << std::endl;
                 // Enqueue the merge task to the thread pool
-                pool.enqueue([batchFiles, outputFileName]
-                             { mergeFiles(batchFiles, outputFileName); });
+                pool.submit(merges, [batchFiles, outputFileName]
+                            { mergeFiles(batchFiles, outputFileName); });
             }
 
-            pool.waitAll();
+            merges.wait();
 
             // Update the files to merge with the newly created output files
             filesToMerge = std::move(outputFilenames);
@@ -525,12 +522,26 @@ int main()
             mergeLastTempFile(filesToMerge, lexicon, termsVec, pool);
 
             // Write the lexicon to file
-            writeLexiconToFile(lexicon);
+            writeLexiconToFile(lexicon, dataDirectory);
+            buildDerivedIndexes(dataDirectory);
+
+            // A new index starts with no deleted documents
+            DocLengthTable docLengths;
+            if (docLengths.open(segmentFile(dataDirectory, "doc_lengths.bin")))
+            {
+                writeTombstones(tombstonesFilename(segmentFile(dataDirectory, "index.bin")), docLengths.size());
+            }
             break;
         }
     }
 
-    logMessage("Merging process completed.");
+    // A new segment goes live once it is in the manifest
+    if (publish ? !publishSegment(dataDirectory) : dataDirectory != SEGMENT_BASE_DIRECTORY && !appendSegment(dataDirectory))
+    {
+        return 1;
+    }
+
+    LOG_INFO("Merging process completed.");
     auto endTime = std::chrono::high_resolution_clock::now();
 
     std::cout << "Time elapsed: " << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << " ms" << std::endl;
@@ -1,6 +1,8 @@
 #include "parser_and_indexer_mt.h"
-#include "thread_pool.h"
+#include "ring_buffer.h"
+#include "spill_writer.h"
 #include "utils.h"
+#include "logger.h"
 #include <thread>
 #include <mutex>
 #include <iostream>
@@ -12,6 +14,7 @@
 #include <iterator>
 #include <sys/stat.h>
 #include <ctime>
+#include <chrono>
 #include <cstdint>
 #include <atomic>
 #include <string>
@@ -24,171 +27,246 @@ const float k1 = 1.5;
 const float b = 0.75;
 const float avgDocLen = 55.9879;
 
-// Log messages to a file (for debugging purposes)
-std::ofstream logFile("../logs/parserMT.log", std::ios::app);
-void logMessage(const std::string &message)
-{
-    if (!logFile.is_open())
-    {
-        std::cerr << "Failed to open log file!" << std::endl;
-        return;
-    }
-    std::time_t currentTime = std::time(nullptr);
-    logFile << std::asctime(std::localtime(&currentTime)) << message << std::endl;
-}
-
 inline float calculateTermFreqScore(float termFreq, float k, float b, float documentLen, float avgDocumentLen)
 {
     return (termFreq * (k + 1)) / (termFreq + k * (1 - b + b * documentLen / avgDocumentLen));
 }
 
-void processPassageMT(int docID, const std::string &passage, std::vector<TermDocPair> &termDocPairs, std::mutex &termDocPairsMutex, std::atomic<int> &fileCounter, std::unordered_map<int, int> &docLengths, std::mutex &docLengthsMutex)
+// Pipeline stages, each its own thread(s), joined by bounded lock-free rings:
+//   reader (1)  --lines-->  tokenizers (N)  --documents-->  inverter (1)  --runs-->  spill (SpillWriter)
+// Only the inverter touches the page table, the document lengths and the run buffer, so
+// none of them needs a lock. A full ring stalls the stage feeding it (backpressure).
+
+// A line of the collection with its docID, which is fixed by the reader: passages are
+// numbered in file order, so every build of a collection assigns the same docIDs
+struct InputLine
 {
-    logMessage("Processing passage for docID: " + std::to_string(docID));
-    auto terms = tokenize(passage);
+    int docID = 0;
+    std::string text;
+};
 
-    // Store the document length
+// A parsed passage on its way from a tokenizer to the inverter
+struct TokenizedDocument
+{
+    int docID = 0;
+    int length = 0;
+    std::string docName;
+    std::vector<TermDocPair> postings;
+};
+
+// Time a stage spent working and waiting, to find the bottleneck
+struct StageStats
+{
+    uint64_t items = 0;
+    double busySeconds = 0;     // Wall time minus the waits below
+    double starvedSeconds = 0;  // Waiting for input
+    double blockedSeconds = 0;  // Waiting for room downstream
+
+    void add(const StageStats &other)
     {
-        std::lock_guard<std::mutex> docLengthsLock(docLengthsMutex);
-        docLengths[docID] = terms.size();
+        items += other.items;
+        busySeconds += other.busySeconds;
+        starvedSeconds += other.starvedSeconds;
+        blockedSeconds += other.blockedSeconds;
     }
 
-    // Reserve space to avoid frequent reallocations
+    void finish(std::chrono::steady_clock::time_point start)
     {
-        std::unique_lock<std::mutex> lock(termDocPairsMutex);
-        if (termDocPairs.capacity() < MAX_RECORDS)
-        {
-            termDocPairs.reserve(MAX_RECORDS);
-        }
+        double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        busySeconds = total - starvedSeconds - blockedSeconds;
     }
 
-    std::map<std::string, int> frequencyMap;
+    void print(const std::string &name) const
+    {
+        std::cout << name << ": " << items << " items, busy " << busySeconds << " s ("
+                  << (busySeconds > 0 ? items / busySeconds : 0) << "/s), starved " << starvedSeconds
+                  << " s, blocked " << blockedSeconds << " s" << std::endl;
+    }
+};
 
-    for (const auto &term : terms)
+// Tokenizer stage: turn lines into documents with their term frequency scores
+static void tokenizeStage(MpmcRing<InputLine> &lines, MpmcRing<TokenizedDocument> &documents, StageStats &stats)
+{
+    auto start = std::chrono::steady_clock::now();
+    InputLine line;
+    TokenizedDocument document;
+    double waited;
+    while (lines.pop(line, waited))
     {
-        if (frequencyMap.count(term))
+        stats.starvedSeconds += waited;
+        size_t tabPos = line.text.find('\t');
+        document.docID = line.docID;
+        document.docName = line.text.substr(0, tabPos);
+        auto terms = tokenize(line.text.substr(tabPos + 1));
+        document.length = terms.size();
+
+        std::map<std::string, int> frequencyMap;
+        for (const auto &term : terms)
         {
             frequencyMap[term]++;
         }
-        else
+        document.postings.clear();
+        document.postings.reserve(frequencyMap.size());
+        for (const auto &termFreqPair : frequencyMap)
         {
-            frequencyMap.insert({term, 1});
+            document.postings.emplace_back(termFreqPair.first, document.docID,
+                                           calculateTermFreqScore(termFreqPair.second, k1, b, document.length, avgDocLen));
         }
+        stats.items++;
+        stats.blockedSeconds += documents.push(document);
     }
-
-    // Lock the mutex while modifying termDocPairs
-    std::unique_lock<std::mutex> termDocPairsLock(termDocPairsMutex);
-
-    int docLen = terms.size();
-
-    // Add terms to termDocPairs
-    for (const auto &termFreqPair : frequencyMap)
-    {
-        termDocPairs.emplace_back(termFreqPair.first, docID,
-                                  calculateTermFreqScore(termFreqPair.second, k1, b, docLen, avgDocLen));
-    }
-
-    // If the vector reaches the max size, move its contents to a local copy
-    if (termDocPairs.size() >= MAX_RECORDS)
-    {
-        std::vector<TermDocPair> termDocPairsCopy(std::move(termDocPairs));
-        termDocPairs.clear(); // Clear the original vector for reuse
-
-        // Unlock the mutex early since we're done with the shared data
-        termDocPairsLock.unlock();
-
-        // Increment the file counter atomically
-        int curFileCounter = fileCounter.fetch_add(1);
-
-        // Save the copied data to a file asynchronously
-        std::cout << "Writing to file with fileCounter: " << curFileCounter << std::endl;
-        saveTermDocPairsToFile(termDocPairsCopy, curFileCounter);
-    }
+    stats.finish(start);
 }
 
-// function similar to generateTermDocPairs but with multi threading
-void generateTermDocPairsMT(const std::string &inputFile, std::unordered_map<int, std::string> &pageTable, ThreadPool *threadPool, std::unordered_map<int, int> &docLengths, std::mutex &docLengthsMutex)
+void generateTermDocPairsMT(const std::string &inputFile, std::unordered_map<int, std::string> &pageTable, size_t tokenizerCount, size_t queueDepth, std::unordered_map<int, int> &docLengths,
+                            const std::string &runDirectory)
 {
     std::ifstream inputFileStream(inputFile);
     if (!inputFileStream.is_open())
     {
-        logMessage("Error opening input file: " + inputFile);
+        LOG_ERROR("Error opening input file: " + inputFile);
         return;
     }
-    std::mutex streamMutex, pageTableMutex, termDocPairsMutex;
-    std::vector<TermDocPair> termDocPairs;
-    std::string line;
-    std::atomic<int> docID(0);
-    std::atomic<int> fileCounter{0};
-
-    while (std::getline(inputFileStream, line))
-    {
-        auto task = [line, &pageTableMutex, &pageTable, &docID, &termDocPairs, &termDocPairsMutex, &fileCounter, &docLengths, &docLengthsMutex]()
+    MpmcRing<InputLine> lines(queueDepth);
+    MpmcRing<TokenizedDocument> documents(queueDepth);
+    StageStats readerStats, inverterStats;
+    std::vector<StageStats> tokenizerStats(tokenizerCount);
+
+    // Reader stage: lines without a passage are skipped and take no docID
+    std::thread reader([&]
+                       {
+        auto start = std::chrono::steady_clock::now();
+        InputLine line;
+        int docID = 0;
+        while (std::getline(inputFileStream, line.text))
         {
-            size_t tabPos = line.find('\t');
-            if (tabPos != std::string::npos)
+            if (line.text.find('\t') == std::string::npos)
             {
-                std::string docName = line.substr(0, tabPos);
-                std::string passage = line.substr(tabPos + 1);
-                int _docId = docID++;
+                continue;
+            }
+            line.docID = docID++;
+            readerStats.items++;
+            readerStats.blockedSeconds += lines.push(line);
+        }
+        lines.close();
+        readerStats.finish(start); });
 
-                {
-                    std::lock_guard<std::mutex> pageTableLock(pageTableMutex);
-                    // Store in page table
-                    pageTable[_docId] = docName;
-                }
+    // Tokenizer stages; the last one to finish closes the documents ring
+    std::atomic<size_t> activeTokenizers{tokenizerCount};
+    std::vector<std::thread> tokenizers;
+    for (size_t i = 0; i < tokenizerCount; ++i)
+    {
+        tokenizers.emplace_back([&, i]
+                                {
+            tokenizeStage(lines, documents, tokenizerStats[i]);
+            if (--activeTokenizers == 0)
+            {
+                documents.close();
+            } });
+    }
 
-                processPassageMT(_docId, passage, termDocPairs, termDocPairsMutex, fileCounter, docLengths, docLengthsMutex);
-            }
-        };
-        if (threadPool)
+    // Inverter stage, on this thread: collect postings into runs for the spill stage
+    auto inverterStart = std::chrono::steady_clock::now();
+    std::vector<TermDocPair> termDocPairs;
+    termDocPairs.reserve(MAX_RECORDS);
+    int fileCounter = 0;
+    SpillWriter spillWriter(4, runDirectory);
+    TokenizedDocument document;
+    double waited;
+    while (documents.pop(document, waited))
+    {
+        inverterStats.starvedSeconds += waited;
+        pageTable[document.docID] = std::move(document.docName);
+        docLengths[document.docID] = document.length;
+        for (auto &posting : document.postings)
         {
-            threadPool->enqueue(task);
+            termDocPairs.push_back(std::move(posting));
         }
-        else
+        inverterStats.items++;
+
+        // If the vector reaches the max size, hand it to the spill thread and keep parsing into the spare buffer
+        if (termDocPairs.size() >= MAX_RECORDS)
         {
-            logMessage("ThreadPool is not defined. Trying single thread one");
-            task();
+            std::cout << "Writing to file with fileCounter: " << fileCounter << std::endl;
+            auto spillStart = std::chrono::steady_clock::now();
+            spillWriter.submit(termDocPairs, fileCounter++);
+            inverterStats.blockedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - spillStart).count();
         }
     }
+    reader.join();
+    for (std::thread &tokenizer : tokenizers)
+    {
+        tokenizer.join();
+    }
 
-    // Wait for all tasks to finish
-    threadPool->waitAll();
+    // Handle any remaining term-doc pairs
+    if (termDocPairs.size() > 0)
+    {
+        std::cout << "Write remaining TermDocPairs to temp." << std::endl;
+        spillWriter.submit(termDocPairs, fileCounter++);
+    }
+    else
+        std::cout << "TermDocPairs size zero! No need to create new" << std::endl;
 
-    // Clean up the thread pool
-    delete threadPool;
+    // Wait for the last spill to be written
+    spillWriter.finish();
+    inverterStats.finish(inverterStart);
 
-    // Handle any remaining term-doc pairs
-    auto task = [&termDocPairs, &termDocPairsMutex, &fileCounter]()
+    StageStats tokenizerTotal;
+    for (const StageStats &stats : tokenizerStats)
     {
-        std::lock_guard<std::mutex> termDocPairsLock(termDocPairsMutex);
-        if (termDocPairs.size() > 0)
-        {
-            std::cout << "Write remaining TermDocPairs to temp." << std::endl;
-            saveTermDocPairsToFile(termDocPairs, fileCounter++);
-        }
-        else
-            std::cout << "TermDocPairs size zero! No need to create new" << std::endl;
-    };
-    task();
+        tokenizerTotal.add(stats);
+    }
+    readerStats.print("Reader");
+    tokenizerTotal.print("Tokenizers (" + std::to_string(tokenizerCount) + ", summed)");
+    inverterStats.print("Inverter (blocked = waiting on spills)");
+    std::cout << "Spill: " << fileCounter << " runs" << std::endl;
 }
 
-#include <chrono>
-
 int main(int argc, char *argv[])
 {
     auto startTime = std::chrono::high_resolution_clock::now();
     int threadNum = 8; // Default thread number
-
-    // Check if a command line argument is provided
-    if (argc > 1)
+    int queueDepth = 1024; // Documents in flight between two stages
+
+    // Positional: thread count, queue depth. --input FILE parses another collection file and
+    // --output DIR writes its runs and document tables there, e.g. to build a new segment.
+    // --log-level debug|info|warn|error|off sets what goes to the log (default info).
+    startLogging("../logs/parserMT.log");
+    std::string inputFile = "../data/collection.tsv";
+    std::string outputDirectory = "../data";
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--input" && i + 1 < argc)
+        {
+            inputFile = argv[++i];
+        }
+        else if (arg == "--output" && i + 1 < argc)
+        {
+            outputDirectory = argv[++i];
+        }
+        else if (arg == "--log-level" && i + 1 < argc)
+        {
+            LogLevel level;
+            if (parseLogLevel(argv[++i], level))
+            {
+                setLogLevel(level);
+            }
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() > 0)
     {
-        threadNum = std::atoi(argv[1]); // Convert argument to integer
+        threadNum = std::atoi(positional[0].c_str()); // Convert argument to integer
     }
-    int maxWorks = 16;
-    if (argc > 2)
+    if (positional.size() > 1)
     {
-        maxWorks = std::atoi(argv[2]); // Convert argument to integer
+        queueDepth = std::atoi(positional[1].c_str()); // Convert argument to integer
     }
 
     if (threadNum <= 0)
@@ -196,34 +274,32 @@ int main(int argc, char *argv[])
         threadNum = 8;
     }
 
-    if (maxWorks <= 0)
+    if (queueDepth <= 0)
     {
-        maxWorks = 16;
+        queueDepth = 1024;
     }
     {
-        ThreadPool *pool = new ThreadPool(threadNum, maxWorks);
 
-        createDirectory("../data");
-        createDirectory("../data/intermediate");
+        createDirectory(outputDirectory);
+        createDirectory(outputDirectory + "/intermediate");
 
         // Data structures for the page table and document lengths
         std::unordered_map<int, std::string> pageTable;
         std::unordered_map<int, int> docLengths;
-        std::mutex docLengthsMutex;
 
-        generateTermDocPairsMT("../data/collection.tsv", pageTable, pool, docLengths, docLengthsMutex);
+        generateTermDocPairsMT(inputFile, pageTable, threadNum, queueDepth, docLengths, outputDirectory + "/intermediate");
 
         // Write the page table to file
-        writePageTableToFile(pageTable);
+        writePageTableToFile(pageTable, outputDirectory + "/page_table.bin");
 
         // Write the document lengths to file
-        writeDocLengthsToFile(docLengths);
+        writeDocLengthsToFile(docLengths, outputDirectory + "/doc_lengths.bin");
 
-        logMessage("Parsing process with multi-threading completed.");
+        LOG_INFO("Parsing process with multi-threading completed.");
     }
     auto endTime = std::chrono::high_resolution_clock::now();
 
     std::cout << "time passed: " << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << std::endl;
-    logMessage("Time passed:" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count()));
+    LOG_INFO("Time passed: " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count()));
     return 0;
 }
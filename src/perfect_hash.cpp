@@ -0,0 +1,201 @@
+#include "perfect_hash.h"
+#include "file_write_buffer.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#define KEYS_PER_BUCKET 4
+// Pilots tried per bucket before giving up on a seed: the last buckets go into a nearly full
+// table and need about keyCount / free slots tries, so the limit grows with the key count
+#define MIN_MAX_PILOT (1u << 16)
+#define MAX_PILOTS_PER_KEY 8
+#define MAX_SEED_ATTEMPTS 16
+
+static inline uint64_t fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// Map a 64-bit value uniformly onto [0, n) without a division
+static inline uint64_t fastRange(uint64_t value, uint64_t n) {
+    return static_cast<uint64_t>((static_cast<__uint128_t>(value) * n) >> 64);
+}
+
+static inline uint64_t pilotHash(uint32_t pilot, uint64_t seed) {
+    return fmix64(pilot ^ (seed * 0x9E3779B97F4A7C15ULL));
+}
+
+// Mixed after the XOR: keys of a bucket whose hashes are close would otherwise stay close
+// under every pilot and land in the same slot whatever the pilot
+static inline uint64_t slotFor(uint64_t hash, uint64_t displacement, uint64_t n) {
+    return fastRange(fmix64(hash ^ displacement), n);
+}
+
+// MurmurHash64A-style hash over the term bytes
+uint64_t hashTerm(std::string_view term, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = seed ^ (term.size() * m);
+
+    size_t blocks = term.size() / 8;
+    for (size_t i = 0; i < blocks; ++i) {
+        uint64_t k;
+        std::memcpy(&k, term.data() + i * 8, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    const unsigned char *tail = reinterpret_cast<const unsigned char *>(term.data()) + blocks * 8;
+    switch (term.size() & 7) {
+    case 7: h ^= uint64_t(tail[6]) << 48; [[fallthrough]];
+    case 6: h ^= uint64_t(tail[5]) << 40; [[fallthrough]];
+    case 5: h ^= uint64_t(tail[4]) << 32; [[fallthrough]];
+    case 4: h ^= uint64_t(tail[3]) << 24; [[fallthrough]];
+    case 3: h ^= uint64_t(tail[2]) << 16; [[fallthrough]];
+    case 2: h ^= uint64_t(tail[1]) << 8; [[fallthrough]];
+    case 1: h ^= uint64_t(tail[0]);
+            h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+// --- Builder ---
+
+// Try to place every bucket with one seed; returns false if some bucket cannot be placed
+static bool placeBuckets(const std::vector<uint64_t> &hashes, uint64_t seed, uint32_t bucketCount,
+                         std::vector<uint32_t> &pilots, std::vector<PerfectHashSlot> &slots) {
+    uint64_t n = hashes.size();
+
+    // Group keys by bucket (counting sort)
+    std::vector<uint32_t> bucketStart(bucketCount + 1, 0);
+    for (uint64_t h : hashes) {
+        bucketStart[fastRange(h >> 32 | h << 32, bucketCount) + 1]++;
+    }
+    for (uint32_t b = 0; b < bucketCount; ++b) {
+        bucketStart[b + 1] += bucketStart[b];
+    }
+    std::vector<uint32_t> keysByBucket(n);
+    std::vector<uint32_t> fill(bucketStart.begin(), bucketStart.end() - 1);
+    for (uint32_t i = 0; i < n; ++i) {
+        uint64_t h = hashes[i];
+        keysByBucket[fill[fastRange(h >> 32 | h << 32, bucketCount)]++] = i;
+    }
+
+    // Largest buckets first, while the table is still empty
+    std::vector<uint32_t> bucketOrder(bucketCount);
+    for (uint32_t b = 0; b < bucketCount; ++b) bucketOrder[b] = b;
+    std::stable_sort(bucketOrder.begin(), bucketOrder.end(), [&bucketStart](uint32_t a, uint32_t b) {
+        return bucketStart[a + 1] - bucketStart[a] > bucketStart[b + 1] - bucketStart[b];
+    });
+
+    uint32_t maxPilot = static_cast<uint32_t>(std::min<uint64_t>(std::max<uint64_t>(MIN_MAX_PILOT, n * MAX_PILOTS_PER_KEY), 1u << 30));
+    std::vector<bool> taken(n, false);
+    std::vector<uint64_t> positions;
+    pilots.assign(bucketCount, 0);
+    slots.assign(n, PerfectHashSlot{0, 0});
+    for (uint32_t b : bucketOrder) {
+        uint32_t size = bucketStart[b + 1] - bucketStart[b];
+        if (size == 0) break;
+        const uint32_t *keys = keysByBucket.data() + bucketStart[b];
+
+        uint32_t pilot = 0;
+        for (; pilot < maxPilot; ++pilot) {
+            uint64_t displacement = pilotHash(pilot, seed);
+            positions.clear();
+            bool ok = true;
+            for (uint32_t k = 0; k < size && ok; ++k) {
+                uint64_t pos = slotFor(hashes[keys[k]], displacement, n);
+                ok = !taken[pos] && std::find(positions.begin(), positions.end(), pos) == positions.end();
+                positions.push_back(pos);
+            }
+            if (ok) break;
+        }
+        if (pilot == maxPilot) return false;
+
+        pilots[b] = pilot;
+        for (uint32_t k = 0; k < size; ++k) {
+            taken[positions[k]] = true;
+            slots[positions[k]] = PerfectHashSlot{static_cast<uint32_t>(hashes[keys[k]]), keys[k]};
+        }
+    }
+    return true;
+}
+
+bool buildPerfectHash(const std::vector<std::string_view> &keys, const std::string &filename) {
+    PerfectHashHeader header = {};
+    header.magic = PERFECT_HASH_MAGIC;
+    header.keyCount = static_cast<uint32_t>(keys.size());
+    header.bucketCount = std::max<uint32_t>(1, (header.keyCount + KEYS_PER_BUCKET - 1) / KEYS_PER_BUCKET);
+
+    std::vector<uint64_t> hashes(keys.size());
+    std::vector<uint32_t> pilots;
+    std::vector<PerfectHashSlot> slots;
+    bool placed = false;
+    for (uint64_t seed = 1; seed <= MAX_SEED_ATTEMPTS && !placed; ++seed) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            hashes[i] = hashTerm(keys[i], seed);
+        }
+        header.seed = seed;
+        placed = placeBuckets(hashes, seed, header.bucketCount, pilots, slots);
+    }
+    if (!placed) {
+        std::cerr << "Failed to build perfect hash for " << keys.size() << " keys" << std::endl;
+        return false;
+    }
+
+    WriteFileBuffer output(filename, 1 << 24);
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char *>(pilots.data()), pilots.size() * sizeof(uint32_t));
+    output.write(reinterpret_cast<const char *>(slots.data()), slots.size() * sizeof(PerfectHashSlot));
+    std::cout << "Perfect hash written to " << filename << " (" << keys.size() << " keys, seed " << header.seed << ")" << std::endl;
+    return true;
+}
+
+// --- Lookup ---
+
+bool PerfectHash::open(const std::string &filename) {
+    header = nullptr;
+    if (!file.open(filename)) {
+        return false;
+    }
+    const PerfectHashHeader *fileHeader = reinterpret_cast<const PerfectHashHeader *>(file.data());
+    if (file.size() < sizeof(PerfectHashHeader) || fileHeader->magic != PERFECT_HASH_MAGIC ||
+        file.size() < sizeof(PerfectHashHeader) + fileHeader->bucketCount * sizeof(uint32_t) +
+                          fileHeader->keyCount * sizeof(PerfectHashSlot)) {
+        std::cerr << "Invalid perfect hash file: " << filename << std::endl;
+        file.close();
+        return false;
+    }
+    header = fileHeader;
+    pilots = reinterpret_cast<const uint32_t *>(file.data() + sizeof(PerfectHashHeader));
+    slots = reinterpret_cast<const PerfectHashSlot *>(pilots + header->bucketCount);
+    return true;
+}
+
+void PerfectHash::close() {
+    header = nullptr;
+    file.close();
+}
+
+uint64_t PerfectHash::slotOf(uint64_t hash) const {
+    uint32_t bucket = static_cast<uint32_t>(fastRange(hash >> 32 | hash << 32, header->bucketCount));
+    return slotFor(hash, pilotHash(pilots[bucket], header->seed), header->keyCount);
+}
+
+int64_t PerfectHash::find(std::string_view key) const {
+    if (!header || header->keyCount == 0) return -1;
+    uint64_t hash = hashTerm(key, header->seed);
+    const PerfectHashSlot &slot = slots[slotOf(hash)];
+    return slot.fingerprint == static_cast<uint32_t>(hash) ? static_cast<int64_t>(slot.value) : -1;
+}
@@ -0,0 +1,82 @@
+#include "posting_list.h"
+#include "compression.h"
+#include <algorithm>
+#include <cstring>
+
+// Pick the block boundaries of a list; returns the end of each block
+static std::vector<size_t> chooseBlocks(const std::vector<std::pair<int, float>> &postings) {
+    std::vector<size_t> ends;
+    size_t n = postings.size();
+    if (n <= static_cast<size_t>(MAX_BLOCK_POSTINGS)) {
+        ends.push_back(n);
+        return ends;
+    }
+
+    size_t target = n > static_cast<size_t>(LONG_LIST_POSTINGS) ? LONG_LIST_BLOCK_SIZE : BLOCK_SIZE;
+    double averageGap = static_cast<double>(postings.back().first - postings.front().first) / (n - 1);
+    size_t start = 0;
+    while (start < n) {
+        if (n - start <= 2 * target) {
+            ends.push_back(n);
+            break;
+        }
+        // Cut at the widest gap between half and twice the target, if it stands out
+        size_t end = start + target;
+        int widestGap = 0;
+        size_t widestAt = end;
+        for (size_t cut = start + target / 2; cut <= start + 2 * target && cut < n; ++cut) {
+            int gap = postings[cut].first - postings[cut - 1].first;
+            if (gap > widestGap) {
+                widestGap = gap;
+                widestAt = cut;
+            }
+        }
+        if (widestGap >= BLOCK_GAP_FACTOR * averageGap) {
+            end = widestAt;
+        }
+        ends.push_back(end);
+        start = end;
+    }
+    return ends;
+}
+
+int encodePostingList(const std::vector<std::pair<int, float>> &postings, std::vector<unsigned char> &out) {
+    out.clear();
+    std::vector<size_t> ends = chooseBlocks(postings);
+    int blockCount = static_cast<int>(ends.size());
+    size_t tableSize = blockCount > 1 ? blockCount * sizeof(SkipEntry) : 0;
+    out.resize(tableSize);
+
+    std::vector<unsigned char> encodedNumber;
+    size_t blockStart = 0;
+    for (int block = 0; block < blockCount; ++block) {
+        size_t blockEnd = ends[block];
+
+        SkipEntry entry;
+        entry.maxDocID = postings[blockEnd - 1].first;
+        entry.offset = static_cast<uint32_t>(out.size() - tableSize);
+        entry.docCount = static_cast<uint16_t>(blockEnd - blockStart);
+
+        // For the first docID in the block, store as absolute value; for the rest, store docID gaps
+        int lastDocID = 0;
+        for (size_t i = blockStart; i < blockEnd; ++i) {
+            varbyteEncode(postings[i].first - lastDocID, encodedNumber);
+            out.insert(out.end(), encodedNumber.begin(), encodedNumber.end());
+            lastDocID = postings[i].first;
+        }
+        entry.docIDBytes = static_cast<uint16_t>(out.size() - tableSize - entry.offset);
+
+        // Then, the term frequency scores
+        size_t scoresStart = out.size();
+        out.resize(scoresStart + (blockEnd - blockStart) * sizeof(float));
+        for (size_t i = blockStart; i < blockEnd; ++i) {
+            std::memcpy(out.data() + scoresStart + (i - blockStart) * sizeof(float), &postings[i].second, sizeof(float));
+        }
+
+        if (tableSize > 0) {
+            std::memcpy(out.data() + block * sizeof(SkipEntry), &entry, sizeof(SkipEntry));
+        }
+        blockStart = blockEnd;
+    }
+    return blockCount;
+}
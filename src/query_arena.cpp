@@ -0,0 +1,44 @@
+#include "query_arena.h"
+#include <algorithm>
+#include <cstdint>
+
+QueryArena::QueryArena(size_t chunkSize) : chunkSize(chunkSize), current(0), used(0) {
+}
+
+QueryArena::~QueryArena() {
+    for (auto &chunk : chunks) {
+        ::operator delete(chunk.data);
+    }
+}
+
+void *QueryArena::allocate(size_t size, size_t alignment) {
+    while (current < chunks.size()) {
+        Chunk &chunk = chunks[current];
+        uintptr_t base = reinterpret_cast<uintptr_t>(chunk.data);
+        size_t start = ((base + used + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+        if (start + size <= chunk.size) {
+            used = start + size;
+            return chunk.data + start;
+        }
+        // Move on to the next chunk kept from earlier queries
+        current++;
+        used = 0;
+    }
+
+    // Only reached while the arena is still growing
+    size_t newSize = std::max(chunkSize, size + alignment);
+    chunks.push_back(Chunk{static_cast<char *>(::operator new(newSize)), newSize});
+    current = chunks.size() - 1;
+    used = 0;
+    return allocate(size, alignment);
+}
+
+void QueryArena::reset() {
+    current = 0;
+    used = 0;
+}
+
+QueryArena &QueryArena::local() {
+    static thread_local QueryArena arena;
+    return arena;
+}
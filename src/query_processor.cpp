@@ -1,318 +1,820 @@
 // query_processor.cpp
 #include "query_processor.h"
 #include "compression.h"
+#include "intersection.h"
+#include "score_accumulator.h"
 #include <iostream>
 #include <fstream>
-#include <sstream>
 #include <algorithm>
-#include <queue>
-#include <tuple>
 #include <cmath>
+#include <cctype>
+#include <climits>
+#include <cstdint>
 
 
 
 // --- QueryProcessor Implementation ---
 
 // Constructor
-QueryProcessor::QueryProcessor(const std::string &indexFilename, const std::string &lexiconFilename, const std::string &pageTableFilename, const std::string &docLengthsFilename)
+QueryProcessor::QueryProcessor(const std::string &indexFilename, const std::string &lexiconFilename, const std::string &pageTableFilename, const std::string &docLengthsFilename,
+                               std::ostream &messages)
     : invertedIndex(indexFilename, lexiconFilename) {
-    // Load the page table
-    loadPageTable(pageTableFilename);
-
-    // Load document lengths
-    loadDocumentLengths(docLengthsFilename);
+    // Map the page table and document lengths; both are indexed directly by docID
+    pageTable.open(pageTableFilename);
+    docLengths.open(docLengthsFilename);
 
     // Total number of documents
     totalDocs = docLengths.size();
-    // After loading document lengths
-    std::cout << "Total Documents: " << totalDocs << std::endl;
+    messages << "Total Documents: " << totalDocs << std::endl;
+
+    // Average document length comes from the stored total
+    avgDocLength = docLengths.averageLength();
+    messages << "Average Document Length: " << avgDocLength << std::endl;
 
-    // Compute average document length
-    double totalDocLength = 0.0;
-    for (const auto& [docID, length] : docLengths) {
-        totalDocLength += length;
+    // The impact-ordered index is optional (temp_file_merger --impact)
+    if (impactIndex.open(impactIndexFilename(indexFilename)) && impactIndex.termCount() != invertedIndex.termCount()) {
+        std::cerr << "Ignoring impact index built for a different lexicon" << std::endl;
+        impactIndex.close();
     }
-    avgDocLength = totalDocLength / totalDocs;
-    std::cout << "Average Document Length: " << avgDocLength << std::endl;
-}
 
-// Parse the query into terms
-std::vector<std::string> QueryProcessor::parseQuery(const std::string &query) {
-    std::vector<std::string> terms;
-    std::istringstream iss(query);
-    std::string term;
-    while (iss >> term) {
-        // Normalize term: lowercase, remove punctuation
-        term.erase(std::remove_if(term.begin(), term.end(), ::ispunct), term.end());
-        std::transform(term.begin(), term.end(), term.begin(), ::tolower);
-        if (!term.empty()) {
-            terms.push_back(term);
+    // Champion lists sit next to the lexicon
+    if (champions.open(championListsFilename(lexiconFilename)) && champions.termCount() != invertedIndex.termCount()) {
+        std::cerr << "Ignoring champion lists built for a different lexicon" << std::endl;
+        champions.close();
+    }
+
+    // So is the tier-1 index (temp_file_merger --tier1 N)
+    if (tier1.open(tier1IndexFilename(indexFilename))) {
+        if (tier1.termCount() != invertedIndex.termCount()) {
+            std::cerr << "Ignoring tier-1 index built for a different lexicon" << std::endl;
+            tier1 = Tier1Index();
+        } else {
+            messages << "Tier-1 index loaded: " << tier1.sizeBytes() << " bytes" << std::endl;
         }
     }
-    return terms;
-}
 
-// Load the page table from file
-void QueryProcessor::loadPageTable(const std::string &pageTableFilename) {
-    std::ifstream pageTableFile(pageTableFilename, std::ios::binary);
-    if (!pageTableFile.is_open()) {
-        std::cerr << "Error opening page table file: " << pageTableFilename << std::endl;
-        return;
+    // Deleted documents, if the index has a tombstones file (delete_docs)
+    if (tombstones.open(tombstonesFilename(indexFilename)) && tombstones.docCount() != static_cast<uint64_t>(totalDocs)) {
+        std::cerr << "Ignoring tombstones written for a different index" << std::endl;
+        tombstones.close();
     }
+    tombstonesVersion.store(tombstones.version());
 
-    while (pageTableFile.peek() != EOF) {
-        int docID;
-        pageTableFile.read(reinterpret_cast<char*>(&docID), sizeof(docID));
+    setCacheSizes(RESULT_CACHE_BYTES, BLOCK_CACHE_BYTES);
+}
 
-        uint16_t nameLength;
-        pageTableFile.read(reinterpret_cast<char*>(&nameLength), sizeof(nameLength));
+void QueryProcessor::setParallelism(size_t threads, int64_t minPostings, std::shared_ptr<ThreadPool> pool) {
+    if (threads > 1 && !pool) {
+        pool = std::make_shared<ThreadPool>(threads - 1);
+    }
+    rangePool = threads > 1 ? std::move(pool) : nullptr;
+    rangeCount = std::max<size_t>(threads, 1);
+    parallelMinPostings = minPostings;
+}
 
-        std::string docName(nameLength, ' ');
-        pageTableFile.read(&docName[0], nameLength);
+void QueryProcessor::setCacheSizes(size_t resultBytes, size_t blockBytes) {
+    resultCache.resize(resultBytes);
+    blockCache.resize(blockBytes);
+    invertedIndex.setBlockCache(blockCache.enabled() ? &blockCache : nullptr);
+}
 
-        pageTable[docID] = docName;
+// Parse the query into terms: split on whitespace, lowercase, remove punctuation.
+// Terms are copied into the arena, so nothing here touches the heap.
+size_t QueryProcessor::parseQuery(std::string_view query, QueryArena &arena, std::string_view *&terms) {
+    size_t words = 0;
+    bool inWord = false;
+    for (char c : query) {
+        bool space = std::isspace(static_cast<unsigned char>(c));
+        if (!space && !inWord) words++;
+        inWord = !space;
     }
-
-    pageTableFile.close();
+    terms = arena.allocateArray<std::string_view>(words);
+    char *buffer = arena.allocateArray<char>(query.size());
+
+    size_t count = 0, length = 0, i = 0;
+    while (i < query.size()) {
+        while (i < query.size() && std::isspace(static_cast<unsigned char>(query[i]))) i++;
+        size_t start = length;
+        while (i < query.size() && !std::isspace(static_cast<unsigned char>(query[i]))) {
+            unsigned char c = query[i++];
+            // Normalize term: lowercase, remove punctuation
+            if (!std::ispunct(c)) buffer[length++] = std::tolower(c);
+        }
+        if (length > start) {
+            terms[count++] = std::string_view(buffer + start, length - start);
+        }
+    }
+    return count;
 }
 
-// Load document lengths from file
-void QueryProcessor::loadDocumentLengths(const std::string &docLengthsFilename) {
-    std::ifstream docLengthsFile(docLengthsFilename, std::ios::binary);
-    if (!docLengthsFile.is_open()) {
-        std::cerr << "Error opening document lengths file: " << docLengthsFilename << std::endl;
-        return;
+#include <chrono>
+
+size_t QueryProcessor::search(std::string_view query, bool conjunctive, size_t k, SearchResult *results) {
+    QueryArena &arena = QueryArena::local();
+    arena.reset();
+
+    std::string_view *terms;
+    size_t termCount = parseQuery(query, arena, terms);
+
+    // Look up each term in the lexicon
+    uint32_t *termIndices = arena.allocateArray<uint32_t>(termCount);
+    size_t foundCount = 0;
+    for (size_t i = 0; i < termCount; ++i) {
+        int64_t termIndex = invertedIndex.findTerm(terms[i]);
+        if (termIndex < 0) {
+            if (reportMissingTerms) std::cout << "Term not found: " << terms[i] << std::endl;
+            continue;
+        }
+        termIndices[foundCount++] = static_cast<uint32_t>(termIndex);
+    }
+    if (foundCount == 0) {
+        return 0;
     }
 
-    while (docLengthsFile.peek() != EOF) {
-        int docID;
-        int docLength;
-        docLengthsFile.read(reinterpret_cast<char*>(&docID), sizeof(docID));
-        docLengthsFile.read(reinterpret_cast<char*>(&docLength), sizeof(docLength));
-        docLengths[docID] = docLength;
+    // Cached results may hold documents deleted since: entries only count under the version
+    // they were computed for, and the first query to see a new version drops the old ones
+    uint64_t version = tombstones.version();
+    uint64_t cleared = tombstonesVersion.load(std::memory_order_acquire);
+    if (version != cleared && tombstonesVersion.compare_exchange_strong(cleared, version)) {
+        resultCache.clear();
     }
-    // After loading document lengths
-    std::cout << "Number of Document Lengths Loaded: " << docLengths.size() << std::endl;
 
-    for (const auto& [docID, length] : docLengths) {
-        if (length <= 0) {
-            std::cout << "Invalid document length for DocID " << docID << ": " << length << std::endl;
+    // Results under a time budget depend on the machine's load, so they are not cached
+    bool cacheable = resultCache.enabled() && foundCount <= RESULT_CACHE_MAX_TERMS && k <= RESULT_CACHE_MAX_K &&
+                     budget.milliseconds <= 0;
+    ResultCacheKey key = {};
+    if (cacheable) {
+        std::copy(termIndices, termIndices + foundCount, key.terms);
+        key.termCount = static_cast<uint32_t>(foundCount);
+        key.conjunctive = conjunctive;
+        key.k = static_cast<uint32_t>(k);
+        size_t resultCount = 0;
+        bool hit = false;
+        resultCache.lookup(key, [&](const CachedResults &cached) {
+            if (cached.version != version) return;
+            std::copy(cached.results, cached.results + cached.count, results);
+            resultCount = cached.count;
+            hit = true;
+        });
+        if (hit) {
+            return resultCount;
         }
     }
 
-    docLengthsFile.close();
+    size_t resultCount = evaluate(termIndices, foundCount, conjunctive, k, results);
+    if (cacheable) {
+        resultCache.insert(key, [&](CachedResults &cached) {
+            cached.version = version;
+            std::copy(results, results + resultCount, cached.results);
+            cached.count = static_cast<uint32_t>(resultCount);
+        });
+    }
+    return resultCount;
 }
-#include <chrono>
 
-void QueryProcessor::processQuery(const std::string &query, bool conjunctive) {
-    auto startTime = std::chrono::high_resolution_clock::now();
-    auto terms = parseQuery(query);
+size_t QueryProcessor::searchTerms(const std::string_view *terms, const float *termIDFs, size_t termCount, bool conjunctive, size_t k, SearchResult *results) {
+    QueryArena &arena = QueryArena::local();
+    uint32_t *termIndices = arena.allocateArray<uint32_t>(termCount);
+    float *idfs = arena.allocateArray<float>(termCount);
+    size_t foundCount = 0;
+    for (size_t i = 0; i < termCount; ++i) {
+        int64_t termIndex = invertedIndex.findTerm(terms[i]);
+        if (termIndex < 0) {
+            if (conjunctive) {
+                return 0;
+            }
+            continue;
+        }
+        termIndices[foundCount] = static_cast<uint32_t>(termIndex);
+        idfs[foundCount++] = termIDFs[i];
+    }
+    if (foundCount == 0) {
+        return 0;
+    }
+    return evaluate(termIndices, foundCount, conjunctive, k, results, idfs);
+}
 
-    if (terms.empty()) {
-        std::cout << "No terms found in query." << std::endl;
-        return;
+// Cursors over the terms' lists, in the arena, weighed with termIDFs when given
+InvertedListPointer *QueryProcessor::openCursors(const uint32_t *termIndices, size_t termCount, const float *termIDFs) const {
+    QueryArena &arena = QueryArena::local();
+    InvertedListPointer *cursors = arena.allocateArray<InvertedListPointer>(termCount);
+    for (size_t i = 0; i < termCount; ++i) {
+        int *docBuffer = arena.allocateArray<int>(MAX_BLOCK_POSTINGS);
+        new (&cursors[i]) InvertedListPointer(invertedIndex.openList(termIndices[i], docBuffer));
+        if (termIDFs) {
+            cursors[i].setIDF(termIDFs[i]);
+        }
     }
+    return cursors;
+}
 
-    // Open inverted lists for each term and store term-pointer pairs
-    std::vector<std::pair<std::string, InvertedListPointer>> termPointers;
-    for (const auto &term : terms) {
-        if (!invertedIndex.openList(term)) {
-            std::cout << "Term not found: " << term << std::endl;
-            continue;
+size_t QueryProcessor::evaluate(const uint32_t *termIndices, size_t foundCount, bool conjunctive, size_t k, SearchResult *results,
+                                const float *termIDFs) {
+    // Precomputed scores embed this index's IDFs; with IDFs from outside only the lists are used
+    bool ownIDFs = termIDFs == nullptr;
+
+    // A single frequent term is answered from its champion list without touching the index,
+    // unless deletions left fewer than k of its champions
+    const uint64_t *deleted = tombstones.deletedBitmap();
+    if (ownIDFs && foundCount == 1 && champions.isOpen() && k <= champions.listSize()) {
+        if (const ChampionEntry *list = champions.list(termIndices[0])) {
+            size_t count = 0;
+            for (size_t i = 0; i < champions.listSize() && count < k; ++i) {
+                if (!tombstones.isDeleted(list[i].docID)) {
+                    results[count++] = SearchResult{list[i].docID, list[i].score};
+                }
+            }
+            if (count == k) {
+                return k;
+            }
         }
-        termPointers.emplace_back(term, invertedIndex.getListPointer(term));
     }
 
-    if (termPointers.empty()) {
-        std::cout << "No valid terms found in query." << std::endl;
-        return;
+    if (ownIDFs && !conjunctive && tierMode != TIER_OFF && tier1.isOpen()) {
+        size_t resultCount;
+        if (searchTier1(termIndices, foundCount, k, results, resultCount)) {
+            return resultCount;
+        }
+    }
+
+    TopK topK(results, k);
+    topK.exclude(deleted);
+    if (ownIDFs && !conjunctive && traversal == TRAVERSAL_SAAT && impactIndex.isOpen()) {
+        scoreAtATime(termIndices, foundCount, topK);
+        return topK.finish();
     }
 
-    // DAAT Processing
-    std::unordered_map<int, double> docScores;  // docID -> aggregated score
+    // Open a cursor for each term
+    InvertedListPointer *cursors = openCursors(termIndices, foundCount, termIDFs);
+    size_t cursorCount = foundCount;
 
     if (conjunctive) {
-        // Initialize docIDs for each list
-        std::vector<int> docIDs;
-        for (auto &tp : termPointers) {
-            auto &ptr = tp.second;
-            if (!ptr.isValid()) {  // Check if list is empty
-                ptr.close();
-                return;  // One of the lists is empty, no results
+        conjunctiveDAAT(cursors, cursorCount, topK);
+        return topK.finish();
+    }
+    if (ownIDFs) {
+        seedThreshold(termIndices, foundCount, k, topK);
+    }
+    if (rangeCount > 1) {
+        int64_t postings = 0;
+        for (size_t i = 0; i < cursorCount; ++i) {
+            postings += cursors[i].getDocFrequency();
+        }
+        if (postings >= parallelMinPostings) {
+            return disjunctiveParallel(termIndices, foundCount, termIDFs, cursors, topK.threshold(), k, results);
+        }
+    }
+    if (preferTAAT(cursors, cursorCount)) {
+        disjunctiveTAAT(cursors, cursorCount, topK);
+    } else {
+        disjunctiveDAAT(cursors, cursorCount, topK);
+    }
+    return topK.finish();
+}
+
+// BM25 contribution of every cursor at its current posting, summed in query term order
+static double scoreCurrent(const InvertedListPointer *cursors, size_t cursorCount) {
+    double totalScore = 0.0;
+    for (size_t i = 0; i < cursorCount; ++i) {
+        float bm25Score = cursors[i].getIDF() * cursors[i].getTFS();
+        totalScore += bm25Score;
+    }
+    return totalScore;
+}
+
+// Probe lists order[from..count) for docID with nextGEQ, rarest first. Returns true if all
+// of them contain it; sets exhausted when one of them has run out.
+static bool probeLists(InvertedListPointer **order, size_t from, size_t count, int docID, bool &exhausted) {
+    for (size_t i = from; i < count; ++i) {
+        if (!order[i]->nextGEQ(docID)) {
+            exhausted = true;
+            return false;
+        }
+        if (order[i]->getDocID() != docID) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The two rarest lists are block-encoded: intersect them a block pair at a time
+static void intersectBlockPair(InvertedListPointer *cursors, InvertedListPointer **order, size_t cursorCount, TopK &topK) {
+    QueryArena &arena = QueryArena::local();
+    InvertedListPointer &lead = *order[0];
+    InvertedListPointer &second = *order[1];
+    int *leadMatches = arena.allocateArray<int>(MAX_BLOCK_POSTINGS);
+    int *secondMatches = arena.allocateArray<int>(MAX_BLOCK_POSTINGS);
+    bool exhausted = false;
+    while (true) {
+        if (!second.nextGEQ(lead.getDocID())) {
+            return;  // Reached end of list
+        }
+
+        // Intersect the rest of the two current blocks
+        const int *leadDocIDs = lead.blockDocIDs();
+        const int *secondDocIDs = second.blockDocIDs();
+        int leadStart = lead.blockPosition(), leadEnd = lead.blockSize();
+        int secondStart = second.blockPosition(), secondEnd = second.blockSize();
+        size_t matches = intersectBlocks(leadDocIDs + leadStart, leadEnd - leadStart,
+                                         secondDocIDs + secondStart, secondEnd - secondStart,
+                                         leadMatches, secondMatches);
+
+        for (size_t m = 0; m < matches; ++m) {
+            lead.seekInBlock(leadStart + leadMatches[m]);
+            second.seekInBlock(secondStart + secondMatches[m]);
+            int docID = lead.getDocID();
+            if (probeLists(order, 2, cursorCount, docID, exhausted)) {
+                topK.push(docID, scoreCurrent(cursors, cursorCount));
+            } else if (exhausted) {
+                return;
             }
-            if (!ptr.next()) {  // Move to first element
-                ptr.close();
-                return;  // Empty list
+        }
+
+        // Move on from whichever block ends first
+        int leadLast = leadDocIDs[leadEnd - 1];
+        int secondLast = secondDocIDs[secondEnd - 1];
+        if (leadLast <= secondLast) {
+            if (!lead.nextBlock()) {
+                return;
             }
-            docIDs.push_back(ptr.getDocID());
-        }
-        std::cout << "Starting docID size: " << docIDs.size() << std::endl;
-        while (true) {
-            int maxDocID = *std::max_element(docIDs.begin(), docIDs.end());
-            bool allMatch = true;
-
-            // Advance pointers where docID < maxDocID
-            for (size_t i = 0; i < termPointers.size(); ++i) {
-                auto &ptr = termPointers[i].second;
-                while (docIDs[i] < maxDocID) {
-                    if (!ptr.nextGEQ(maxDocID)) {
-                        allMatch = false;
-                        break;  // Reached end of list
-                    }
-                    docIDs[i] = ptr.getDocID();
-                }
-                if (docIDs[i] != maxDocID) {
-                    allMatch = false;
-                }
+        } else if (!lead.nextGEQ(secondLast + 1)) {
+            return;
+        }
+    }
+}
+
+// The two rarest lists are bitmap-encoded: AND their bitmap chunks a word at a time
+static void intersectBitmapPair(InvertedListPointer *cursors, InvertedListPointer **order, size_t cursorCount, TopK &topK) {
+    InvertedListPointer &lead = *order[0];
+    InvertedListPointer &second = *order[1];
+    uint64_t *words = QueryArena::local().allocateArray<uint64_t>(BITMAP_CHUNK_WORDS);
+    bool exhausted = false;
+    while (true) {
+        if (!second.nextGEQ(lead.getDocID())) {
+            return;
+        }
+        if (second.getDocID() != lead.getDocID()) {
+            if (!lead.nextGEQ(second.getDocID())) {
+                return;
             }
+            continue;
+        }
 
-            if (!allMatch) {
-                // Check if any list has reached the end
-                bool anyEnd = false;
-                for (auto &tp : termPointers) {
-                    if (!tp.second.isValid()) {
-                        anyEnd = true;
-                        break;
-                    }
+        int docID = lead.getDocID();
+        const unsigned char *leadBits = lead.chunkBitmap();
+        const unsigned char *secondBits = second.chunkBitmap();
+        if (!leadBits || !secondBits) {
+            // An array chunk on either side: take this match and step the lead
+            if (probeLists(order, 2, cursorCount, docID, exhausted)) {
+                topK.push(docID, scoreCurrent(cursors, cursorCount));
+            } else if (exhausted) {
+                return;
+            }
+            if (!lead.next()) {
+                return;
+            }
+            continue;
+        }
+
+        andBitmapChunks(leadBits, secondBits, words);
+        int chunkBase = docID & ~0xFFFF;
+        int firstWord = (docID & 0xFFFF) >> 6;
+        words[firstWord] &= ~uint64_t(0) << (docID & 63);  // Drop matches already behind the cursors
+        for (int w = firstWord; w < BITMAP_CHUNK_WORDS; ++w) {
+            uint64_t bits = words[w];
+            if (bits) bits &= ~topK.excludedWord((chunkBase >> 6) + w);  // Deleted matches are not probed
+            for (; bits; bits &= bits - 1) {
+                int match = chunkBase | (w << 6) | __builtin_ctzll(bits);
+                lead.nextGEQ(match);
+                second.nextGEQ(match);
+                if (probeLists(order, 2, cursorCount, match, exhausted)) {
+                    topK.push(match, scoreCurrent(cursors, cursorCount));
+                } else if (exhausted) {
+                    return;
                 }
-                if (anyEnd) break;
-                continue;
             }
-            // allMatch equal to true
-            // All pointers are at the same docID
-            int docID = maxDocID;
-            double totalScore = 0.0;
-            for (auto &tp : termPointers) {
-                auto &ptr = tp.second;
-                const std::string &term = tp.first;
-
-                // Compute BM25 score
-                // int tf = ptr.getTF(); // Assuming TF = 1
-                // int docLength = docLengths[docID];
-                // int df = invertedIndex.getDocFrequency(term);
-                // double idf = std::log((totalDocs - df + 0.5) / (df + 0.5));
-                // double K = k1 * ((1 - b) + b * (static_cast<double>(docLength) / avgDocLength));
-                // double bm25Score = idf * ((k1 + 1) * tf) / (K + tf);
-                float bm25Score = ptr.getIDF() * ptr.getTFS();
-                totalScore += bm25Score;
+        }
 
-                ptr.next();  // Advance pointer for next iteration
+        // Carry on from the next chunk
+        if (chunkBase > INT_MAX - (1 << BITMAP_CHUNK_BITS) || !lead.nextGEQ(chunkBase + (1 << BITMAP_CHUNK_BITS))) {
+            return;
+        }
+    }
+}
+
+// Set-vs-set intersection: lists are ordered by document frequency and the rarest drives.
+// The two rarest lists are intersected a block pair (or bitmap chunk pair) at a time when
+// they share the block or bitmap encoding; each common docID is then probed in the remaining lists, rarest
+// first, with galloping nextGEQ. Bitmap lists answer those probes with a bit test and
+// Elias-Fano lists with a select on their upper bits.
+void QueryProcessor::conjunctiveDAAT(InvertedListPointer *cursors, size_t cursorCount, TopK &topK) {
+    InvertedListPointer **order = QueryArena::local().allocateArray<InvertedListPointer *>(cursorCount);
+    for (size_t i = 0; i < cursorCount; ++i) {
+        order[i] = &cursors[i];
+    }
+    std::sort(order, order + cursorCount, [](const InvertedListPointer *a, const InvertedListPointer *b) {
+        return a->getDocFrequency() < b->getDocFrequency();
+    });
+
+    InvertedListPointer &lead = *order[0];
+    if (!lead.next()) {
+        return;  // Empty list, no results
+    }
+    if (cursorCount >= 2 && lead.getEncoding() == order[1]->getEncoding()) {
+        if (lead.getEncoding() == LIST_ENCODING_BLOCKS) {
+            intersectBlockPair(cursors, order, cursorCount, topK);
+            return;
+        }
+        if (lead.getEncoding() == LIST_ENCODING_BITMAP) {
+            intersectBitmapPair(cursors, order, cursorCount, topK);
+            return;
+        }
+    }
+
+    // Otherwise (mixed encodings, Elias-Fano lists, a single list) the lead walks its
+    // postings and probes the rest
+    bool exhausted = false;
+    while (true) {
+        int docID = lead.getDocID();
+        if (probeLists(order, 1, cursorCount, docID, exhausted)) {
+            topK.push(docID, scoreCurrent(cursors, cursorCount));
+            if (!lead.next()) {
+                return;
             }
-            docScores[docID] = totalScore;
-
-            // Update docIDs
-            bool validPointers = true;
-            for (size_t i = 0; i < termPointers.size(); ++i) {
-                auto &ptr = termPointers[i].second;
-                if (ptr.isValid()) {
-                    docIDs[i] = ptr.getDocID();
-                } else {
-                    // One of the lists has reached the end
-                    validPointers = false;
-                    break;
-                }
+        } else if (exhausted) {
+            return;
+        } else {
+            // Some list skipped past docID; jump the lead to the first candidate after it
+            int candidate = docID + 1;
+            for (size_t i = 1; i < cursorCount; ++i) {
+                candidate = std::max(candidate, order[i]->getDocID());
+            }
+            if (!lead.nextGEQ(candidate)) {
+                return;
             }
-            if (!validPointers) break;
         }
-    } else {
-        // Disjunctive query processing using a min-heap
-        auto cmp = [](std::pair<InvertedListPointer*, std::string> a, std::pair<InvertedListPointer*, std::string> b) {
-            return a.first->getDocID() > b.first->getDocID();
-        };
-        std::priority_queue<
-            std::pair<InvertedListPointer*, std::string>,
-            std::vector<std::pair<InvertedListPointer*, std::string>>,
-            decltype(cmp)> pq(cmp);
-
-        // Initialize heap with the first posting from each term
-        for (auto &tp : termPointers) {
-            auto &ptr = tp.second;
-            const std::string &term = tp.first;
-            if (ptr.isValid() && ptr.next()) {
-                pq.push({&ptr, term});
+    }
+}
+
+// Score every document in any list, always advancing the lists at the smallest docID
+void QueryProcessor::disjunctiveDAAT(InvertedListPointer *cursors, size_t cursorCount, TopK &topK) {
+    for (size_t i = 0; i < cursorCount; ++i) {
+        cursors[i].next();
+    }
+    while (true) {
+        int docID = INT_MAX;
+        for (size_t i = 0; i < cursorCount; ++i) {
+            if (cursors[i].isValid()) {
+                docID = std::min(docID, cursors[i].getDocID());
             }
         }
+        if (docID == INT_MAX) {
+            break;
+        }
 
-        while (!pq.empty()) {
-            auto [ptr, term] = pq.top();
-            pq.pop();
+        double totalScore = 0.0;
+        for (size_t i = 0; i < cursorCount; ++i) {
+            if (cursors[i].isValid() && cursors[i].getDocID() == docID) {
+                float bm25Score = cursors[i].getIDF() * cursors[i].getTFS();
+                totalScore += bm25Score;
+                cursors[i].next();
+            }
+        }
+        topK.push(docID, totalScore);
+    }
+}
+
+bool QueryProcessor::preferTAAT(const InvertedListPointer *cursors, size_t cursorCount) const {
+    if (traversal != TRAVERSAL_AUTO) {
+        return traversal != TRAVERSAL_DAAT;  // Also when score at a time was asked for without an impact index
+    }
+    int64_t postings = 0;
+    for (size_t i = 0; i < cursorCount; ++i) {
+        postings += cursors[i].getDocFrequency();
+    }
+    return postings * TAAT_MIN_DENSITY >= totalDocs;
+}
 
-            int docID = ptr->getDocID();
+// Add each list's impacts into the dense accumulator, one term at a time and block by
+// block, then pull the top-k out of the accumulator in docID order
+void QueryProcessor::disjunctiveTAAT(InvertedListPointer *cursors, size_t cursorCount, TopK &topK) {
+    ScoreAccumulator &accumulator = ScoreAccumulator::local();
+    accumulator.begin(totalDocs);
+
+    // Terms go in query order, so every document's score is summed as in DAAT
+    for (size_t i = 0; i < cursorCount; ++i) {
+        InvertedListPointer &cursor = cursors[i];
+        if (!cursor.next()) {
+            continue;
+        }
+        float idf = cursor.getIDF();
+        if (cursor.getEncoding() == LIST_ENCODING_BLOCKS) {
+            do {
+                const int *docIDs = cursor.blockDocIDs();
+                for (int pos = 0; pos < cursor.blockSize(); ++pos) {
+                    float bm25Score = idf * cursor.blockScore(pos);
+                    accumulator.add(docIDs[pos], bm25Score);
+                }
+            } while (cursor.nextBlock());
+        } else {
+            do {
+                float bm25Score = idf * cursor.getTFS();
+                accumulator.add(cursor.getDocID(), bm25Score);
+            } while (cursor.next());
+        }
+    }
+    accumulator.collect(topK);
+}
 
-            // Compute BM25 score
-            // int tf = ptr->getTF(); // Assuming TF = 1
-            // int docLength = docLengths[docID];
-            // int df = invertedIndex.getDocFrequency(term);
-            // double idf = std::log((totalDocs - df + 0.5) / (df + 0.5));
-            // double K = k1 * ((1 - b) + b * (static_cast<double>(docLength) / avgDocLength));
-            // double bm25Score = idf * ((k1 + 1) * tf) / (K + tf);
-            float bm25Score = ptr->getIDF() * ptr->getTFS();
+// Raise the threshold shared by the ranges of a query to score, if that is higher
+static void publishThreshold(std::atomic<double> &sharedThreshold, double score) {
+    double current = sharedThreshold.load(std::memory_order_relaxed);
+    while (score > current && !sharedThreshold.compare_exchange_weak(current, score, std::memory_order_relaxed)) {
+    }
+}
 
-            docScores[docID] += bm25Score;
+// Documents scored between two looks at the shared threshold
+const int RANGE_THRESHOLD_INTERVAL = 1024;
+
+// Split the docID space into one range per worker. Boundaries follow the blocks of the
+// longest block-encoded list, so no block is decoded by two ranges and the ranges get about
+// the same number of its postings; without one the space is cut evenly.
+static void splitRanges(const InvertedListPointer *cursors, size_t cursorCount, int docCount, size_t rangeCount, int *bounds) {
+    const InvertedListPointer *longest = nullptr;
+    for (size_t i = 0; i < cursorCount; ++i) {
+        if (cursors[i].getEncoding() == LIST_ENCODING_BLOCKS && cursors[i].blockCount() >= static_cast<int>(rangeCount) &&
+            (!longest || cursors[i].blockCount() > longest->blockCount())) {
+            longest = &cursors[i];
+        }
+    }
+    bounds[0] = 0;
+    for (size_t r = 1; r < rangeCount; ++r) {
+        bounds[r] = longest ? longest->blockMaxDocID(static_cast<int>(r * longest->blockCount() / rangeCount) - 1) + 1
+                            : static_cast<int>(static_cast<int64_t>(docCount) * r / rangeCount);
+        bounds[r] = std::max(bounds[r], bounds[r - 1]);
+    }
+    bounds[rangeCount] = INT_MAX;
+}
 
-            // Advance the pointer and re-add to the heap if valid
-            if (ptr->next()) {
-                pq.push({ptr, term});
+// Score the documents in [firstDocID, endDocID) with fresh cursors, DAAT or TAAT as for
+// a whole query. topK takes the shared threshold as its floor as it goes and publishes
+// its own k-th score once full, so every range prunes with the best bound found so far.
+void QueryProcessor::disjunctiveRange(const uint32_t *termIndices, size_t termCount, const float *termIDFs, int firstDocID, int endDocID, TopK &topK, std::atomic<double> &sharedThreshold) {
+    InvertedListPointer *cursors = openCursors(termIndices, termCount, termIDFs);
+    topK.raiseFloor(sharedThreshold.load(std::memory_order_relaxed));
+
+    if (preferTAAT(cursors, termCount)) {
+        ScoreAccumulator &accumulator = ScoreAccumulator::local();
+        accumulator.begin(totalDocs);
+        for (size_t i = 0; i < termCount; ++i) {
+            InvertedListPointer &cursor = cursors[i];
+            if (!cursor.nextGEQ(firstDocID)) {
+                continue;
             }
+            float idf = cursor.getIDF();
+            do {
+                if (cursor.getDocID() >= endDocID) break;
+                float bm25Score = idf * cursor.getTFS();
+                accumulator.add(cursor.getDocID(), bm25Score);
+            } while (cursor.next());
+        }
+        topK.raiseFloor(sharedThreshold.load(std::memory_order_relaxed));
+        accumulator.collect(topK);
+        if (topK.full()) {
+            publishThreshold(sharedThreshold, topK.threshold());
         }
+        return;
     }
 
-    // Close all inverted lists
-    for (auto &tp : termPointers) {
-        tp.second.close();
+    for (size_t i = 0; i < termCount; ++i) {
+        cursors[i].nextGEQ(firstDocID);
     }
+    int scored = 0;
+    while (true) {
+        int docID = INT_MAX;
+        for (size_t i = 0; i < termCount; ++i) {
+            if (cursors[i].isValid()) {
+                docID = std::min(docID, cursors[i].getDocID());
+            }
+        }
+        if (docID >= endDocID) {
+            break;
+        }
 
-    if (docScores.empty()) {
-        std::cout << "No documents matched the query." << std::endl;
-        return;
+        double totalScore = 0.0;
+        for (size_t i = 0; i < termCount; ++i) {
+            if (cursors[i].isValid() && cursors[i].getDocID() == docID) {
+                float bm25Score = cursors[i].getIDF() * cursors[i].getTFS();
+                totalScore += bm25Score;
+                cursors[i].next();
+            }
+        }
+        if (topK.push(docID, totalScore) && topK.full()) {
+            publishThreshold(sharedThreshold, topK.threshold());
+        }
+        if (++scored == RANGE_THRESHOLD_INTERVAL) {
+            scored = 0;
+            topK.raiseFloor(sharedThreshold.load(std::memory_order_relaxed));
+        }
     }
+}
 
-    // Rank documents by aggregated score
-    std::vector<std::pair<int, double>> rankedDocs(docScores.begin(), docScores.end());
+// Run one docID range per worker (the calling thread takes the first) and merge their
+// top-k lists. Each range sums scores in query term order, so results match a serial run.
+size_t QueryProcessor::disjunctiveParallel(const uint32_t *termIndices, size_t termCount, const float *termIDFs, const InvertedListPointer *cursors, double seed, size_t k, SearchResult *results) {
+    QueryArena &arena = QueryArena::local();
+    int *bounds = arena.allocateArray<int>(rangeCount + 1);
+    splitRanges(cursors, termCount, totalDocs, rangeCount, bounds);
+    SearchResult *partial = arena.allocateArray<SearchResult>(rangeCount * k);
+    size_t *partialCounts = arena.allocateArray<size_t>(rangeCount);
+    std::atomic<double> sharedThreshold(seed);
+
+    TaskGroup ranges;
+    auto runRange = [&, this](size_t r) {
+        TopK topK(partial + r * k, k);
+        topK.exclude(tombstones.deletedBitmap());
+        disjunctiveRange(termIndices, termCount, termIDFs, bounds[r], bounds[r + 1], topK, sharedThreshold);
+        partialCounts[r] = topK.size();
+    };
+    for (size_t r = 1; r < rangeCount; ++r) {
+        rangePool->submit(ranges, [&, r] {
+            // Pool workers start from a clean arena; the caller may pick up a range while waiting
+            if (&QueryArena::local() != &arena) QueryArena::local().reset();
+            runRange(r);
+        });
+    }
+    runRange(0);
+    ranges.wait();
 
-    // Sort by score in descending order
-    std::sort(rankedDocs.begin(), rankedDocs.end(), [](const auto &a, const auto &b) {
-        return a.second > b.second;
+    TopK topK(results, k);
+    for (size_t r = 0; r < rangeCount; ++r) {
+        for (size_t i = 0; i < partialCounts[r]; ++i) {
+            topK.push(partial[r * k + i].docID, partial[r * k + i].score);
+        }
+    }
+    return topK.finish();
+}
+
+namespace {
+
+struct SegmentRef {
+    uint32_t impact;
+    uint32_t term;   // Position of the term in the query, to break ties
+    uint32_t count;
+    const unsigned char *docIDs;
+};
+
+// Postings decoded between two looks at the clock
+const size_t SAAT_CLOCK_INTERVAL = 4096;
+
+} // namespace
+
+// Walk the segments of all query terms from the highest impact down, adding impacts into
+// the accumulator, until everything is scored or the budget runs out. Scores are the
+// quantized impacts, so they approximate the exact BM25 sums.
+void QueryProcessor::scoreAtATime(const uint32_t *termIndices, size_t termCount, TopK &topK) {
+    QueryArena &arena = QueryArena::local();
+    size_t segmentCount = 0;
+    for (size_t i = 0; i < termCount; ++i) {
+        segmentCount += impactIndex.segmentCount(termIndices[i]);
+    }
+    SegmentRef *segments = arena.allocateArray<SegmentRef>(segmentCount);
+    size_t next = 0;
+    for (size_t i = 0; i < termCount; ++i) {
+        for (uint32_t s = 0; s < impactIndex.segmentCount(termIndices[i]); ++s) {
+            ImpactSegment segment = impactIndex.segment(termIndices[i], s);
+            segments[next++] = {segment.impact, static_cast<uint32_t>(i), segment.count,
+                                impactIndex.segmentData(termIndices[i], segment)};
+        }
+    }
+    std::sort(segments, segments + segmentCount, [](const SegmentRef &a, const SegmentRef &b) {
+        return a.impact != b.impact ? a.impact > b.impact : a.term < b.term;
     });
 
-    // Display top 10 results
-    int resultsCount = std::min(10, static_cast<int>(rankedDocs.size()));
-    for (int i = 0; i < resultsCount; ++i) {
-        int docID = rankedDocs[i].first;
-        double score = rankedDocs[i].second;
-        std::string docName = pageTable[docID];
-        std::cout << i + 1 << ". DocID: " << docID << ", DocName: " << docName << ", Score: " << score << std::endl;
+    ScoreAccumulator &accumulator = ScoreAccumulator::local();
+    accumulator.begin(totalDocs);
+    auto startTime = std::chrono::steady_clock::now();
+    size_t postingsLeft = budget.postings ? budget.postings : SIZE_MAX;
+    for (size_t s = 0; s < segmentCount && postingsLeft > 0; ++s) {
+        double score = segments[s].impact * impactIndex.scale();
+        size_t count = std::min<size_t>(segments[s].count, postingsLeft);
+        size_t pos = 0;
+        int docID = 0;
+        for (size_t done = 0; done < count;) {
+            if (budget.milliseconds > 0 &&
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() >= budget.milliseconds) {
+                accumulator.collect(topK);
+                return;
+            }
+            size_t end = std::min(count, done + SAAT_CLOCK_INTERVAL);
+            for (; done < end; ++done) {
+                docID += varbyteDecodeNumber(segments[s].docIDs, pos);
+                accumulator.add(docID, score);
+            }
+        }
+        postingsLeft -= count;
     }
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "time passed: " << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << std::endl;
+    accumulator.collect(topK);
+}
 
+// The k champions of any query term score at least their own contribution in an OR query,
+// as long as no term can take anything away (every IDF is non-negative). So the best
+// k-th champion score bounds the final k-th score from below before any list is read.
+// Deleted champions do not count.
+void QueryProcessor::seedThreshold(const uint32_t *termIndices, size_t termCount, size_t k, TopK &topK) const {
+    if (!champions.isOpen() || k == 0 || k > champions.listSize()) {
+        return;
+    }
+    double seed = -1e300;
+    for (size_t i = 0; i < termCount; ++i) {
+        if (invertedIndex.getRecord(termIndices[i]).IDF < 0) {
+            return;
+        }
+        if (const ChampionEntry *list = champions.list(termIndices[i])) {
+            size_t live = 0;
+            for (size_t c = 0; c < champions.listSize(); ++c) {
+                if (!tombstones.isDeleted(list[c].docID)) {
+                    if (++live == k) {
+                        seed = std::max(seed, static_cast<double>(list[c].score));
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    topK.raiseFloor(seed);
 }
-// --- Main Function ---
-#include <chrono>
-int main() {
-    QueryProcessor qp("../data/index.bin", "../data/lexicon.bin", "../data/page_table.bin", "../data/doc_lengths.bin");
 
-    std::string query;
-    std::string mode;
+// Answer an OR query from the tier-1 index. In safe mode the candidates are rescored
+// against the full index, and the answer stands only if no document outside them can
+// reach the k-th exact score: such a document has at most the tier-1 threshold from the
+// postings the tier holds, plus each term's residual for the ones it does not. Returns
+// false when the full index has to be searched instead.
+bool QueryProcessor::searchTier1(const uint32_t *termIndices, size_t termCount, size_t k, SearchResult *results, size_t &resultCount) {
+    QueryArena &arena = QueryArena::local();
+    InvertedListPointer *cursors = arena.allocateArray<InvertedListPointer>(termCount);
+    double residual = 0;
+    for (size_t i = 0; i < termCount; ++i) {
+        int *docBuffer = arena.allocateArray<int>(MAX_BLOCK_POSTINGS);
+        new (&cursors[i]) InvertedListPointer(tier1.openList(termIndices[i], docBuffer));
+        residual += tier1.residual(termIndices[i]);
+    }
 
-    std::cout << "Welcome to the Query Processor!" << std::endl;
-    while (true) {
-        std::cout << "\nEnter your query (or type 'exit' to quit): " << std::flush;
-        std::getline(std::cin, query);
-        
-        if (query == "exit") {
-            break;
+    TopK topK(results, k);
+    topK.exclude(tombstones.deletedBitmap());
+    if (preferTAAT(cursors, termCount)) {
+        disjunctiveTAAT(cursors, termCount, topK);
+    } else {
+        disjunctiveDAAT(cursors, termCount, topK);
+    }
+    resultCount = topK.finish();
+    if (tierMode == TIER_APPROXIMATE || residual == 0) {
+        return true;  // Approximate by request, or none of the lists was pruned
+    }
+    if (resultCount < k) {
+        return false;
+    }
+    double tierThreshold = std::max(results[resultCount - 1].score, 0.0);
+
+    // Exact scores of the candidates, summed in query term order as in DAAT
+    std::sort(results, results + resultCount, [](const SearchResult &a, const SearchResult &b) { return a.docID < b.docID; });
+    for (size_t i = 0; i < termCount; ++i) {
+        int *docBuffer = arena.allocateArray<int>(MAX_BLOCK_POSTINGS);
+        new (&cursors[i]) InvertedListPointer(invertedIndex.openList(termIndices[i], docBuffer));
+    }
+    for (size_t r = 0; r < resultCount; ++r) {
+        double totalScore = 0.0;
+        for (size_t i = 0; i < termCount; ++i) {
+            if (cursors[i].nextGEQ(results[r].docID) && cursors[i].getDocID() == results[r].docID) {
+                float bm25Score = cursors[i].getIDF() * cursors[i].getTFS();
+                totalScore += bm25Score;
+            }
         }
+        results[r].score = totalScore;
+    }
+    std::sort(results, results + resultCount, [](const SearchResult &a, const SearchResult &b) { return a.score > b.score; });
+    return results[resultCount - 1].score > tierThreshold + residual;
+}
+
+void QueryProcessor::processQuery(const std::string &query, bool conjunctive) {
+    auto startTime = std::chrono::high_resolution_clock::now();
 
-        std::cout << "Choose mode (AND/OR): " << std::flush;
-        std::getline(std::cin, mode);
+    const size_t resultsWanted = 10;
+    SearchResult results[resultsWanted];
+    size_t resultsCount = search(query, conjunctive, resultsWanted, results);
 
-        bool conjunctive = (mode == "AND" || mode == "and");
-        auto startTime = std::chrono::high_resolution_clock::now();
-        qp.processQuery(query, conjunctive);
-        auto endTime = std::chrono::high_resolution_clock::now();
-        std::cout << "time passed: " << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << std::endl;
+    if (resultsCount == 0) {
+        std::cout << "No documents matched the query." << std::endl;
+        return;
     }
 
-    return 0;
+    // Display top 10 results
+    for (size_t i = 0; i < resultsCount; ++i) {
+        int docID = results[i].docID;
+        char nameBuffer[16];
+        std::cout << i + 1 << ". DocID: " << docID << ", DocName: " << pageTable.docName(docID, nameBuffer)
+                  << ", Score: " << results[i].score << std::endl;
+    }
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout << "time passed: " << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << std::endl;
 }
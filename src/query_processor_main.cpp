@@ -0,0 +1,116 @@
+#include "segmented_query_processor.h"
+#include "logger.h"
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+// --- Main Function ---
+int main(int argc, char *argv[]) {
+    startLogging("../logs/query_processor.log");
+    // Searches every segment in ../data/manifest.txt, or just the index in ../data without one
+    SegmentedQueryProcessor qp;
+
+    // --daat / --taat / --saat force how OR queries are evaluated; by default it is picked per query.
+    // --postings-budget N and --time-budget-ms T bound score-at-a-time queries.
+    // --no-tier1 ignores the tier-1 index; --tier1-approx answers OR queries from it without the exactness check.
+    // Over several segments there is no impact or tier-1 index to use: --saat and --tier1-approx warn and do nothing.
+    // --result-cache-mb N and --block-cache-mb N size the caches (0 turns one off).
+    // --parallel N splits OR queries over --parallel-min-postings postings (default 2^20) into N docID ranges.
+    // --warmup LOG reads the lists of the terms in a sample query log into memory, most frequent first,
+    // before serving (and for every new generation), stopping after --warmup-mb N (default 256) or --warmup-ms T.
+    // --reload-ms N checks the segment manifest every N ms and hot-swaps new generations (0 turns it off).
+    // --log-level debug|info|warn|error|off sets what goes to ../logs/query_processor.log (debug logs every query).
+    QueryBudget budget;
+    size_t resultCacheBytes = RESULT_CACHE_BYTES, blockCacheBytes = BLOCK_CACHE_BYTES;
+    size_t threads = 1;
+    int64_t parallelMinPostings = PARALLEL_MIN_POSTINGS;
+    int reloadMilliseconds = RELOAD_POLL_MILLISECONDS;
+    std::string warmupLog;
+    WarmupBudget warmupBudget;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--daat") {
+            qp.setTraversal(TRAVERSAL_DAAT);
+        } else if (arg == "--taat") {
+            qp.setTraversal(TRAVERSAL_TAAT);
+        } else if (arg == "--saat") {
+            qp.setTraversal(TRAVERSAL_SAAT);
+            if (!qp.hasImpactIndex()) {
+                std::cerr << "No impact index found (build it with temp_file_merger --impact); using TAAT" << std::endl;
+            }
+        } else if (arg == "--postings-budget" && i + 1 < argc) {
+            budget.postings = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--time-budget-ms" && i + 1 < argc) {
+            budget.milliseconds = std::atof(argv[++i]);
+        } else if (arg == "--no-tier1") {
+            qp.setTierMode(TIER_OFF);
+        } else if (arg == "--tier1-approx") {
+            qp.setTierMode(TIER_APPROXIMATE);
+        } else if (arg == "--result-cache-mb" && i + 1 < argc) {
+            resultCacheBytes = std::strtoull(argv[++i], nullptr, 10) << 20;
+        } else if (arg == "--block-cache-mb" && i + 1 < argc) {
+            blockCacheBytes = std::strtoull(argv[++i], nullptr, 10) << 20;
+        } else if (arg == "--parallel" && i + 1 < argc) {
+            threads = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--parallel-min-postings" && i + 1 < argc) {
+            parallelMinPostings = std::strtoll(argv[++i], nullptr, 10);
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            warmupLog = argv[++i];
+        } else if (arg == "--warmup-mb" && i + 1 < argc) {
+            warmupBudget.bytes = std::strtoull(argv[++i], nullptr, 10) << 20;
+        } else if (arg == "--warmup-ms" && i + 1 < argc) {
+            warmupBudget.milliseconds = std::atof(argv[++i]);
+        } else if (arg == "--reload-ms" && i + 1 < argc) {
+            reloadMilliseconds = std::atoi(argv[++i]);
+        } else if (arg == "--log-level" && i + 1 < argc) {
+            LogLevel level;
+            if (parseLogLevel(argv[++i], level)) setLogLevel(level);
+        }
+    }
+    qp.setParallelism(threads, parallelMinPostings);
+    qp.setBudget(budget);
+    qp.setCacheSizes(resultCacheBytes, blockCacheBytes);
+
+    // Queries are taken only once the warmup is over
+    std::vector<std::string> warmupTerms;
+    if (!warmupLog.empty() && readWarmupTerms(warmupLog, warmupTerms)) {
+        qp.setWarmup(std::move(warmupTerms), warmupBudget);
+        WarmupStats warmed = qp.warmUp();
+        std::cout << "Warmup: " << warmed.terms << " terms, " << warmed.bytes / 1024 << " KB of lists in "
+                  << warmed.milliseconds << " ms" << (warmed.complete ? "" : " (budget reached)") << std::endl;
+        LOG_INFO("Warmup from " + warmupLog + ": " + std::to_string(warmed.terms) + " terms, " + std::to_string(warmed.bytes / 1024) + " KB");
+    }
+    qp.startReloading(reloadMilliseconds);
+
+    std::string query;
+    std::string mode;
+
+    std::cout << "Welcome to the Query Processor!" << std::endl;
+    while (true) {
+        std::cout << "\nEnter your query (or type 'exit' to quit): " << std::flush;
+        std::getline(std::cin, query);
+        
+        if (query == "exit") {
+            break;
+        }
+
+        std::cout << "Choose mode (AND/OR): " << std::flush;
+        std::getline(std::cin, mode);
+
+        bool conjunctive = (mode == "AND" || mode == "and");
+        auto startTime = std::chrono::high_resolution_clock::now();
+        qp.processQuery(query, conjunctive);
+        auto endTime = std::chrono::high_resolution_clock::now();
+        std::cout << "time passed: " << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << std::endl;
+    }
+
+    CacheStats results = qp.resultCacheStats(), blocks = qp.blockCacheStats();
+    std::cout << "Result cache: " << results.hits << " hits, " << results.misses << " misses ("
+              << results.hitRate() * 100 << "%), " << results.rejected << " not admitted" << std::endl;
+    std::cout << "Block cache: " << blocks.hits << " hits, " << blocks.misses << " misses ("
+              << blocks.hitRate() * 100 << "%), " << blocks.rejected << " not admitted" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,303 @@
+// Offline docID reordering, run between parsing and merging: reads the temp runs, orders the
+// documents by recursive graph bisection, and rewrites the temp runs, page table and
+// document lengths under the new docIDs. The merger then builds the index as usual.
+//
+// Usage: reorder_docids [--segment DIR] [threads] [iterations]
+// --segment DIR reorders a segment parsed with parser_and_indexer_mt --output DIR, before
+// temp_file_merger --segment DIR builds it; by default the runs in ../data are reordered.
+#include "graph_bisection.h"
+#include "doc_tables.h"
+#include "file_write_buffer.h"
+#include "mapped_file.h"
+#include "segment_manifest.h"
+#include "utils.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+#define REORDER_WRITE_CHUNK 8000000 // Write 8MB at a time
+// Terms of a single document have no gaps to shrink; leave them out of the graph
+const uint32_t REORDER_MIN_DOC_FREQUENCY = 2;
+
+// Call f(term, docID, termFScore) for every record of a temp run:
+// uint16 termLength, char term[termLength], int32 docID, float termFScore
+template <typename F>
+static bool forEachRecord(const MappedFile &run, F f) {
+    const unsigned char *pos = run.data(), *end = run.data() + run.size();
+    while (pos < end) {
+        uint16_t termLength;
+        if (end - pos < static_cast<ptrdiff_t>(sizeof(termLength))) return false;
+        std::memcpy(&termLength, pos, sizeof(termLength));
+        pos += sizeof(termLength);
+        if (end - pos < static_cast<ptrdiff_t>(termLength + sizeof(int32_t) + sizeof(float))) return false;
+        std::string_view term(reinterpret_cast<const char *>(pos), termLength);
+        pos += termLength;
+        int32_t docID;
+        float termFScore;
+        std::memcpy(&docID, pos, sizeof(docID));
+        pos += sizeof(docID);
+        std::memcpy(&termFScore, pos, sizeof(termFScore));
+        pos += sizeof(termFScore);
+        f(term, docID, termFScore);
+    }
+    return true;
+}
+
+// Build the document-term graph from the runs: one pass for document frequencies and
+// per-document counts, one to fill the adjacency lists with the terms that are kept
+static bool buildGraph(const std::vector<std::string> &runs, size_t docCount, ForwardIndex &graph) {
+    std::unordered_map<std::string, uint32_t> termIds;
+    std::vector<uint32_t> docFrequency;
+    std::vector<uint32_t> runTerms;  // Term id of each term group, in run order
+    std::vector<uint64_t> docTerms(docCount + 1, 0);
+
+    for (const std::string &runName : runs) {
+        MappedFile run;
+        if (!run.open(runName)) {
+            std::cerr << "Error opening temp file: " << runName << std::endl;
+            return false;
+        }
+        std::string_view lastTerm;
+        uint32_t termId = 0;
+        bool first = true, badDocID = false;
+        bool complete = forEachRecord(run, [&](std::string_view term, int32_t docID, float) {
+            if (docID < 0 || static_cast<size_t>(docID) >= docCount) {
+                badDocID = true;
+                return;
+            }
+            // Runs are sorted by term, so each term is looked up once per run
+            if (first || term != lastTerm) {
+                auto [it, inserted] = termIds.emplace(std::string(term), static_cast<uint32_t>(docFrequency.size()));
+                if (inserted) docFrequency.push_back(0);
+                termId = it->second;
+                runTerms.push_back(termId);
+                lastTerm = term;
+                first = false;
+            }
+            ++docFrequency[termId];
+            ++docTerms[docID];
+        });
+        if (!complete || badDocID) {
+            std::cerr << "Temp file " << runName << " is truncated or does not match the document tables" << std::endl;
+            return false;
+        }
+    }
+
+    // Dense ids for the terms that stay in the graph
+    std::vector<uint32_t> graphTerm(docFrequency.size(), UINT32_MAX);
+    graph.termCount = 0;
+    for (size_t t = 0; t < docFrequency.size(); ++t) {
+        if (docFrequency[t] >= REORDER_MIN_DOC_FREQUENCY) graphTerm[t] = graph.termCount++;
+    }
+
+    graph.offsets.assign(docCount + 1, 0);
+    for (size_t doc = 0; doc < docCount; ++doc) graph.offsets[doc + 1] = graph.offsets[doc] + docTerms[doc];
+    graph.terms.resize(graph.offsets[docCount]);
+    std::vector<uint64_t> &fill = docTerms;
+    std::copy(graph.offsets.begin(), graph.offsets.end() - 1, fill.begin());
+
+    size_t group = 0;
+    for (const std::string &runName : runs) {
+        MappedFile run;
+        if (!run.open(runName)) return false;
+        std::string_view lastTerm;
+        uint32_t termId = UINT32_MAX;
+        bool first = true;
+        forEachRecord(run, [&](std::string_view term, int32_t docID, float) {
+            if (first || term != lastTerm) {
+                termId = graphTerm[runTerms[group++]];
+                lastTerm = term;
+                first = false;
+            }
+            if (termId != UINT32_MAX) graph.terms[fill[docID]++] = termId;
+        });
+    }
+
+    // Close up the slots of the terms that were left out
+    uint64_t written = 0;
+    for (size_t doc = 0; doc < docCount; ++doc) {
+        uint64_t begin = graph.offsets[doc], end = fill[doc];
+        graph.offsets[doc] = written;
+        for (uint64_t p = begin; p < end; ++p) graph.terms[written++] = graph.terms[p];
+    }
+    graph.offsets[docCount] = written;
+    graph.terms.resize(written);
+    graph.terms.shrink_to_fit();
+    return true;
+}
+
+// Outputs are written next to their inputs under this suffix and renamed over them only
+// once every one of them was written, so a failed run leaves the inputs as they were
+const char *const REORDER_SUFFIX = ".reordered";
+
+// Write a run under the new docIDs to runName + REORDER_SUFFIX, keeping it sorted by (term, docID)
+static bool remapRun(const std::string &runName, const std::vector<uint32_t> &newIDs) {
+    std::string outputName = runName + REORDER_SUFFIX;
+    {
+        MappedFile run;
+        if (!run.open(runName)) {
+            std::cerr << "Error opening temp file: " << runName << std::endl;
+            return false;
+        }
+        try {
+            WriteFileBuffer output(outputName, REORDER_WRITE_CHUNK);
+            std::string_view groupTerm;
+            std::vector<std::pair<int32_t, float>> postings;
+            auto flush = [&] {
+                std::sort(postings.begin(), postings.end(),
+                          [](const std::pair<int32_t, float> &a, const std::pair<int32_t, float> &b) { return a.first < b.first; });
+                uint16_t termLength = static_cast<uint16_t>(groupTerm.size());
+                for (const auto &[docID, termFScore] : postings) {
+                    output.write(reinterpret_cast<const char *>(&termLength), sizeof(termLength));
+                    output.write(groupTerm.data(), termLength);
+                    output.write(reinterpret_cast<const char *>(&docID), sizeof(docID));
+                    output.write(reinterpret_cast<const char *>(&termFScore), sizeof(termFScore));
+                }
+                postings.clear();
+            };
+            forEachRecord(run, [&](std::string_view term, int32_t docID, float termFScore) {
+                if (term != groupTerm && !postings.empty()) flush();
+                groupTerm = term;
+                postings.emplace_back(static_cast<int32_t>(newIDs[docID]), termFScore);
+            });
+            if (!postings.empty()) flush();
+        } catch (const std::runtime_error &e) {
+            std::cerr << e.what() << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Write the page table and document lengths under the new docIDs, with REORDER_SUFFIX
+static bool remapDocTables(const std::string &directory, const std::vector<uint32_t> &newIDs) {
+    std::unordered_map<int, std::string> pageTable;
+    std::unordered_map<int, int> docLengths;
+    {
+        PageTable names;
+        DocLengthTable lengths;
+        if (!names.open(directory + "/page_table.bin") || !lengths.open(directory + "/doc_lengths.bin")) return false;
+        pageTable.reserve(newIDs.size());
+        docLengths.reserve(newIDs.size());
+        char buffer[16];
+        for (size_t doc = 0; doc < newIDs.size(); ++doc) {
+            pageTable[newIDs[doc]] = std::string(names.docName(static_cast<int>(doc), buffer));
+            docLengths[newIDs[doc]] = lengths.length(static_cast<int>(doc));
+        }
+    }
+    return writePageTableToFile(pageTable, directory + "/page_table.bin" + REORDER_SUFFIX) &&
+           writeDocLengthsToFile(docLengths, directory + "/doc_lengths.bin" + REORDER_SUFFIX);
+}
+
+static void printGapStats(const std::string &label, const GapStats &stats) {
+    std::cout << label << ": " << stats.postings << " postings, " << stats.bitsPerPosting() << " log2 gap bits/posting, "
+              << stats.varbyteBytes / (1024.0 * 1024.0) << " MB of varbyte docID gaps" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    startLogging("../logs/reorder_docids.log");
+    std::string directory = SEGMENT_BASE_DIRECTORY;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--segment" && i + 1 < argc) {
+            directory = argv[++i];
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    size_t threads = positional.size() > 0 ? std::strtoull(positional[0].c_str(), nullptr, 10) : std::thread::hardware_concurrency();
+    BisectionOptions options;
+    if (positional.size() > 1) options.iterations = std::atoi(positional[1].c_str());
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::vector<std::string> runs;
+    while (true) {
+        std::string tempFileName = directory + "/intermediate/temp" + std::to_string(runs.size()) + ".bin";
+        if (!fs::exists(tempFileName)) break;
+        runs.push_back(tempFileName);
+    }
+    if (runs.empty()) {
+        std::cerr << "No temp files found for reordering." << std::endl;
+        return 1;
+    }
+
+    size_t docCount;
+    {
+        DocLengthTable docLengths;
+        if (!docLengths.open(directory + "/doc_lengths.bin")) return 1;
+        docCount = docLengths.size();
+    }
+
+    ForwardIndex graph;
+    if (!buildGraph(runs, docCount, graph)) return 1;
+    auto graphTime = std::chrono::high_resolution_clock::now();
+    std::cout << "Graph: " << docCount << " documents, " << graph.termCount << " terms, " << graph.terms.size()
+              << " edges from " << runs.size() << " temp files ("
+              << std::chrono::duration_cast<std::chrono::milliseconds>(graphTime - startTime).count() << " ms)" << std::endl;
+
+    std::vector<uint32_t> identity(docCount);
+    for (size_t doc = 0; doc < docCount; ++doc) identity[doc] = static_cast<uint32_t>(doc);
+    GapStats before = computeGapStats(graph, identity);
+
+    std::vector<uint32_t> order;
+    {
+        ThreadPool pool(std::max<size_t>(threads, 1));
+        order = graphBisectionOrder(graph, pool, options);
+    }
+    auto bisectTime = std::chrono::high_resolution_clock::now();
+    std::cout << "Bisection: " << std::chrono::duration_cast<std::chrono::milliseconds>(bisectTime - graphTime).count()
+              << " ms on " << threads << " threads" << std::endl;
+
+    GapStats after = computeGapStats(graph, order);
+    printGapStats("Before", before);
+    printGapStats("After ", after);
+    if (before.varbyteBytes > 0) {
+        std::cout << "Varbyte docID gaps change by "
+                  << 100.0 * (static_cast<double>(after.varbyteBytes) - before.varbyteBytes) / before.varbyteBytes << "%" << std::endl;
+    }
+    graph = ForwardIndex();
+
+    std::vector<uint32_t> newIDs(docCount);
+    for (size_t newID = 0; newID < docCount; ++newID) newIDs[order[newID]] = static_cast<uint32_t>(newID);
+
+    // Replace the inputs only once all the outputs are written
+    std::vector<std::string> outputs = runs;
+    outputs.push_back(directory + "/page_table.bin");
+    outputs.push_back(directory + "/doc_lengths.bin");
+    bool written = true;
+    for (const std::string &runName : runs) {
+        if (!remapRun(runName, newIDs)) {
+            written = false;
+            break;
+        }
+    }
+    written = written && remapDocTables(directory, newIDs);
+    if (!written) {
+        std::error_code ignored;
+        for (const std::string &output : outputs) fs::remove(output + REORDER_SUFFIX, ignored);
+        std::cerr << "Reordering failed; the temp files and document tables are unchanged" << std::endl;
+        return 1;
+    }
+    for (const std::string &output : outputs) {
+        fs::rename(output + REORDER_SUFFIX, output);
+    }
+
+    LOG_INFO("Reordered " + std::to_string(docCount) + " documents in " + std::to_string(runs.size()) + " temp files of " + directory + ".");
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout << "Time elapsed: " << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "score_accumulator.h"
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void ScoreAccumulator::begin(size_t docCount) {
+    size_t pages = (docCount + ACCUMULATOR_PAGE_SIZE - 1) / ACCUMULATOR_PAGE_SIZE;
+    if (pages > pageQuery.size()) {
+        scores.resize(pages * ACCUMULATOR_PAGE_SIZE);
+        touched.resize(pages * ACCUMULATOR_PAGE_SIZE / 64);
+        pageQuery.resize(pages, query);
+    }
+    if (++query == 0) {
+        // Query numbers wrapped around: forget which pages were cleared when
+        std::fill(pageQuery.begin(), pageQuery.end(), 0);
+        query = 1;
+    }
+}
+
+void ScoreAccumulator::clearPage(size_t page) {
+    std::fill_n(scores.begin() + page * ACCUMULATOR_PAGE_SIZE, ACCUMULATOR_PAGE_SIZE, 0.0);
+    std::fill_n(touched.begin() + page * ACCUMULATOR_PAGE_SIZE / 64, ACCUMULATOR_PAGE_SIZE / 64, 0);
+    pageQuery[page] = query;
+}
+
+void ScoreAccumulator::collect(TopK &topK) const {
+    for (size_t page = 0; page < pageQuery.size(); ++page) {
+        if (pageQuery[page] != query) continue;
+        for (size_t group = page * ACCUMULATOR_PAGE_SIZE / 64; group < (page + 1) * ACCUMULATOR_PAGE_SIZE / 64; ++group) {
+            uint64_t candidates = touched[group];
+            if (!candidates) continue;
+            // Deleted documents drop out 64 at a time
+            candidates &= ~topK.excludedWord(group);
+            if (!candidates) continue;
+
+            // Mask of the 64 documents scoring above the current threshold
+            const double *groupScores = scores.data() + group * 64;
+            double threshold = topK.threshold();
+            uint64_t above = 0;
+#if defined(__SSE2__)
+            __m128d limit = _mm_set1_pd(threshold);
+            for (int i = 0; i < 64; i += 2) {
+                __m128d values = _mm_loadu_pd(groupScores + i);
+                above |= static_cast<uint64_t>(_mm_movemask_pd(_mm_cmpgt_pd(values, limit))) << i;
+            }
+#else
+            for (int i = 0; i < 64; ++i) {
+                above |= static_cast<uint64_t>(groupScores[i] > threshold) << i;
+            }
+#endif
+            for (candidates &= above; candidates; candidates &= candidates - 1) {
+                int i = __builtin_ctzll(candidates);
+                topK.push(static_cast<int>(group * 64 + i), groupScores[i]);
+            }
+        }
+    }
+}
+
+ScoreAccumulator &ScoreAccumulator::local() {
+    static thread_local ScoreAccumulator accumulator;
+    return accumulator;
+}
@@ -0,0 +1,83 @@
+#include "segment_manifest.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+std::string segmentFile(const std::string &directory, const std::string &name) {
+    return directory + "/" + name;
+}
+
+bool readManifest(const std::string &filename, SegmentManifest &manifest) {
+    std::ifstream input(filename);
+    if (!input.is_open()) {
+        return false;
+    }
+    manifest = SegmentManifest();
+    std::string line;
+    while (std::getline(input, line)) {
+        std::istringstream fields(line);
+        std::string kind;
+        fields >> kind;
+        if (kind == "generation") {
+            fields >> manifest.generation;
+        } else if (kind == "segment") {
+            SegmentInfo segment;
+            if (!(fields >> segment.directory >> segment.docBase >> segment.docCount)) {
+                std::cerr << "Malformed manifest line: " << line << std::endl;
+                return false;
+            }
+            if (segment.docBase != manifest.docEnd()) {
+                std::cerr << "Manifest segments do not cover the docIDs contiguously: " << line << std::endl;
+                return false;
+            }
+            manifest.segments.push_back(segment);
+        }
+    }
+    return true;
+}
+
+bool writeManifest(const std::string &filename, const SegmentManifest &manifest) {
+    std::string temporary = filename + ".tmp";
+    {
+        std::ofstream output(temporary, std::ios::trunc);
+        if (!output.is_open()) {
+            std::cerr << "Error opening manifest for writing: " << temporary << std::endl;
+            return false;
+        }
+        output << "generation " << manifest.generation << "\n";
+        for (const SegmentInfo &segment : manifest.segments) {
+            output << "segment " << segment.directory << " " << segment.docBase << " " << segment.docCount << "\n";
+        }
+        if (!output.flush()) {
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+int segmentTier(int64_t docCount) {
+    int tier = 0;
+    for (int64_t size = SEGMENT_TIER_FLOOR_DOCS; docCount > size; size *= SEGMENT_MERGE_FACTOR) {
+        ++tier;
+    }
+    return tier;
+}
+
+// The first run of SEGMENT_MERGE_FACTOR adjacent segments sharing a tier. Appends add
+// small segments at the end, so runs form there and merged segments stay in docID order.
+bool findTieredMerge(const SegmentManifest &manifest, size_t &first, size_t &last) {
+    const std::vector<SegmentInfo> &segments = manifest.segments;
+    size_t runStart = 0;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (segmentTier(segments[i].docCount) != segmentTier(segments[runStart].docCount)) {
+            runStart = i;
+        }
+        if (i + 1 - runStart == SEGMENT_MERGE_FACTOR) {
+            first = runStart;
+            last = i + 1;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,321 @@
+#include "segment_merge.h"
+#include "merge_temp_file.h"
+#include "doc_tables.h"
+#include "file_write_buffer.h"
+#include "inverted_index.h"
+#include "logger.h"
+#include "tombstones.h"
+#include "utils.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+#define SEGMENT_WRITE_CHUNK 40000000 // Write 40MB at a time
+
+static bool segmentDocCount(const std::string &directory, int64_t &docCount) {
+    DocLengthTable docLengths;
+    if (!docLengths.open(segmentFile(directory, "doc_lengths.bin"))) {
+        return false;
+    }
+    docCount = static_cast<int64_t>(docLengths.size());
+    return true;
+}
+
+// The manifest, or one holding just the batch index in SEGMENT_BASE_DIRECTORY if there is none yet
+static bool loadManifest(SegmentManifest &manifest) {
+    if (readManifest(SEGMENT_MANIFEST_FILENAME, manifest)) {
+        return true;
+    }
+    manifest = SegmentManifest();
+    SegmentInfo base;
+    base.directory = SEGMENT_BASE_DIRECTORY;
+    if (!fs::exists(segmentFile(base.directory, "lexicon.bin")) || !segmentDocCount(base.directory, base.docCount)) {
+        std::cerr << "No index in " << base.directory << std::endl;
+        return false;
+    }
+    manifest.segments.push_back(base);
+    return true;
+}
+
+bool appendSegment(const std::string &directory) {
+    // On the first append the batch index becomes segment 0
+    SegmentManifest manifest;
+    if (!loadManifest(manifest)) {
+        return false;
+    }
+    for (const SegmentInfo &segment : manifest.segments) {
+        if (segment.directory == directory) {
+            std::cerr << "Segment " << directory << " is already in the manifest" << std::endl;
+            return false;
+        }
+    }
+
+    SegmentInfo segment;
+    segment.directory = directory;
+    segment.docBase = manifest.docEnd();
+    if (!segmentDocCount(directory, segment.docCount)) {
+        return false;
+    }
+    manifest.segments.push_back(segment);
+    manifest.generation++;
+    if (!writeManifest(SEGMENT_MANIFEST_FILENAME, manifest)) {
+        return false;
+    }
+    std::cout << "Segment " << directory << " added: docIDs " << segment.docBase << ".."
+              << segment.docBase + segment.docCount - 1 << ", " << manifest.segments.size() << " segments" << std::endl;
+    LOG_INFO("Appended segment " + directory);
+    return true;
+}
+
+bool publishSegment(const std::string &directory) {
+    SegmentManifest manifest;
+    readManifest(SEGMENT_MANIFEST_FILENAME, manifest);  // Without one, there is nothing to replace
+
+    SegmentInfo segment;
+    segment.directory = directory;
+    segment.docBase = 0;
+    if (!segmentDocCount(directory, segment.docCount)) {
+        return false;
+    }
+    std::vector<SegmentInfo> previous = manifest.segments;
+    manifest.segments.assign(1, segment);
+    manifest.generation++;
+    if (!writeManifest(SEGMENT_MANIFEST_FILENAME, manifest)) {
+        return false;
+    }
+    std::cout << "Segment " << directory << " published as generation " << manifest.generation << ": "
+              << segment.docCount << " documents" << std::endl;
+
+    // Readers that still map the old segments keep them until they let go
+    std::string root = std::string(SEGMENT_ROOT_DIRECTORY) + "/";
+    for (const SegmentInfo &old : previous) {
+        if (old.directory != directory && old.directory.compare(0, root.size(), root) == 0) {
+            fs::remove_all(old.directory);
+        }
+    }
+    LOG_INFO("Published segment " + directory);
+    return true;
+}
+
+namespace {
+
+// One input segment of a merge, walked term by term in lexicon order
+struct MergeInput {
+    Lexicon lexicon;
+    std::unique_ptr<InvertedIndex> index;
+    Tombstones tombstones;
+    std::vector<uint64_t> deleted;  // Tombstones as the merge started; these documents are dropped
+    int shift = 0;  // Added to local docIDs to number them in the merged segment
+    uint32_t next = 0;
+    std::string term;
+
+    bool done() const { return next >= lexicon.size(); }
+    void advance() {
+        if (++next < lexicon.size()) term = lexicon.term(next);
+    }
+};
+
+} // namespace
+
+bool mergeSegments(const std::vector<SegmentInfo> &inputs, const std::string &outputDirectory, TombstonesLocks &locks) {
+    fs::create_directories(outputDirectory);
+    std::vector<std::unique_ptr<MergeInput>> sources;
+    for (const SegmentInfo &segment : inputs) {
+        std::unique_ptr<MergeInput> source(new MergeInput());
+        std::string lexiconFilename = segmentFile(segment.directory, "lexicon.bin");
+        if (!source->lexicon.open(lexiconFilename)) {
+            std::cerr << "Error opening segment lexicon: " << lexiconFilename << std::endl;
+            return false;
+        }
+        source->index.reset(new InvertedIndex(segmentFile(segment.directory, "index.bin"), lexiconFilename));
+        source->shift = static_cast<int>(segment.docBase - inputs.front().docBase);
+        source->deleted.assign((segment.docCount + 63) / 64, 0);
+        if (source->tombstones.open(tombstonesFilename(segmentFile(segment.directory, "index.bin"))) &&
+            source->tombstones.docCount() == static_cast<uint64_t>(segment.docCount)) {
+            for (size_t w = 0; w < source->deleted.size(); ++w) {
+                source->deleted[w] = source->tombstones.deletedBitmap() ? source->tombstones.deletedBitmap()[w] : 0;
+            }
+        } else {
+            source->tombstones.close();
+        }
+        if (source->lexicon.size() > 0) source->term = source->lexicon.term(0);
+        sources.push_back(std::move(source));
+    }
+
+    // Merge the sorted vocabularies; a term's postings are concatenated in segment order,
+    // which keeps them sorted since the segments follow each other in docID order. Postings
+    // of deleted documents are left out; the documents keep their docIDs.
+    std::vector<std::pair<std::string, LexiconEntry>> lexicon;
+    std::vector<std::pair<int, float>> postings;
+    std::vector<unsigned char> encodedList;
+    std::vector<int> docBuffer(MAX_BLOCK_POSTINGS);
+    int64_t offset = 0;
+    {
+        WriteFileBuffer indexFile(segmentFile(outputDirectory, "index.bin"), SEGMENT_WRITE_CHUNK);
+        while (true) {
+            const std::string *term = nullptr;
+            for (const auto &source : sources) {
+                if (!source->done() && (!term || source->term < *term)) term = &source->term;
+            }
+            if (!term) break;
+            std::string current = *term;
+
+            postings.clear();
+            for (const auto &source : sources) {
+                if (source->done() || source->term != current) continue;
+                InvertedListPointer cursor = source->index->openList(source->next, docBuffer.data());
+                while (cursor.next()) {
+                    int docID = cursor.getDocID();
+                    if (source->deleted[docID >> 6] >> (docID & 63) & 1) continue;
+                    postings.emplace_back(docID + source->shift, cursor.getTFS());
+                }
+                source->advance();
+            }
+            if (postings.empty()) continue;
+
+            LexiconEntry entry = encodePostings(postings, encodedList);
+            entry.offset = offset;
+            indexFile.write(reinterpret_cast<const char *>(encodedList.data()), encodedList.size());
+            offset += encodedList.size();
+            lexicon.emplace_back(current, entry);
+        }
+    }
+    writeLexiconToFile(lexicon, outputDirectory);
+    buildDerivedIndexes(outputDirectory);
+
+    // Document tables, renumbered like the postings
+    std::unordered_map<int, std::string> pageTable;
+    std::unordered_map<int, int> docLengths;
+    char nameBuffer[16];
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        PageTable names;
+        DocLengthTable lengths;
+        if (!names.open(segmentFile(inputs[i].directory, "page_table.bin")) ||
+            !lengths.open(segmentFile(inputs[i].directory, "doc_lengths.bin"))) {
+            return false;
+        }
+        for (uint64_t doc = 0; doc < lengths.size(); ++doc) {
+            int docID = static_cast<int>(doc) + sources[i]->shift;
+            pageTable[docID] = std::string(names.docName(static_cast<int>(doc), nameBuffer));
+            docLengths[docID] = lengths.length(static_cast<int>(doc));
+        }
+    }
+    writePageTableToFile(pageTable, segmentFile(outputDirectory, "page_table.bin"));
+    writeDocLengthsToFile(docLengths, segmentFile(outputDirectory, "doc_lengths.bin"));
+
+    // Documents deleted while the merge ran still have postings in it and carry over as
+    // tombstones. The inputs' tombstones stay locked from here until the caller has switched
+    // the manifest over, so later deletes wait and then go to the merged segment.
+    uint64_t docCount = inputs.back().docBase + inputs.back().docCount - inputs.front().docBase;
+    std::vector<uint64_t> tombstones((docCount + 63) / 64, 0);
+    int64_t dropped = 0;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const auto &source = sources[i];
+        std::string filename = tombstonesFilename(segmentFile(inputs[i].directory, "index.bin"));
+        if (!fs::exists(filename) && !writeTombstones(filename, inputs[i].docCount)) {
+            return false;
+        }
+        // Opened again under the lock: delete_docs may have created the file meanwhile
+        if (!locks.lock(filename) || !source->tombstones.open(filename)) {
+            return false;
+        }
+        const uint64_t *current = source->tombstones.docCount() == static_cast<uint64_t>(inputs[i].docCount)
+                                      ? source->tombstones.deletedBitmap()
+                                      : nullptr;
+        for (size_t w = 0; w < source->deleted.size(); ++w) {
+            dropped += __builtin_popcountll(source->deleted[w]);
+            uint64_t late = current ? current[w] & ~source->deleted[w] : 0;
+            for (; late; late &= late - 1) {
+                int docID = static_cast<int>(w * 64 + __builtin_ctzll(late)) + source->shift;
+                tombstones[docID >> 6] |= uint64_t(1) << (docID & 63);
+            }
+        }
+    }
+    if (!writeTombstones(tombstonesFilename(segmentFile(outputDirectory, "index.bin")), docCount, tombstones.data())) {
+        return false;
+    }
+    std::cout << "Merged " << inputs.size() << " segments into " << outputDirectory << ": " << lexicon.size()
+              << " terms, " << offset << " bytes of postings, " << dropped << " deleted documents dropped" << std::endl;
+    return true;
+}
+
+// A segment with at least SEGMENT_EXPUNGE_PERCENT of its documents deleted, to be rewritten
+// on its own to drop their postings
+static bool findExpunge(const SegmentManifest &manifest, size_t &first, size_t &last) {
+    for (size_t i = 0; i < manifest.segments.size(); ++i) {
+        const SegmentInfo &segment = manifest.segments[i];
+        Tombstones tombstones;
+        if (!tombstones.open(tombstonesFilename(segmentFile(segment.directory, "index.bin")))) continue;
+        if (segment.docCount > 0 && tombstones.deletedCount() * 100 >= static_cast<uint64_t>(segment.docCount) * SEGMENT_EXPUNGE_PERCENT) {
+            first = i;
+            last = i + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool sameSegments(const std::vector<SegmentInfo> &a, size_t aFirst, const std::vector<SegmentInfo> &b, size_t bFirst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (aFirst + i >= a.size() || bFirst + i >= b.size() || a[aFirst + i].directory != b[bFirst + i].directory) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int compactSegments() {
+    int merges = 0;
+    while (true) {
+        SegmentManifest manifest;
+        if (!loadManifest(manifest)) {
+            return -1;
+        }
+        size_t first, last;
+        if (!findTieredMerge(manifest, first, last) && !findExpunge(manifest, first, last)) {
+            return merges;
+        }
+        std::vector<SegmentInfo> inputs(manifest.segments.begin() + first, manifest.segments.begin() + last);
+        SegmentInfo merged;
+        merged.directory = std::string(SEGMENT_ROOT_DIRECTORY) + "/merged_" + std::to_string(manifest.generation + 1);
+        merged.docBase = inputs.front().docBase;
+        merged.docCount = inputs.back().docBase + inputs.back().docCount - merged.docBase;
+        std::cout << "Merging segments " << first << ".." << last - 1 << " (tier " << segmentTier(inputs.front().docCount)
+                  << ") into " << merged.directory << std::endl;
+        TombstonesLocks locks;
+        if (!mergeSegments(inputs, merged.directory, locks)) {
+            return -1;
+        }
+
+        // Segments may have been appended meanwhile; only the merged ones are replaced
+        SegmentManifest current;
+        if (!loadManifest(current) ||
+            !sameSegments(current.segments, first, inputs, 0, inputs.size())) {
+            std::cerr << "Segment manifest changed during the merge; dropping " << merged.directory << std::endl;
+            fs::remove_all(merged.directory);
+            return -1;
+        }
+        current.segments.erase(current.segments.begin() + first, current.segments.begin() + last);
+        current.segments.insert(current.segments.begin() + first, merged);
+        current.generation = std::max(current.generation, manifest.generation) + 1;
+        if (!writeManifest(SEGMENT_MANIFEST_FILENAME, current)) {
+            return -1;
+        }
+        // Deletes that waited see the new manifest and look the documents up again
+        locks.unlock();
+
+        // Readers that still map the old segments keep them until they let go
+        std::string root = std::string(SEGMENT_ROOT_DIRECTORY) + "/";
+        for (const SegmentInfo &segment : inputs) {
+            if (segment.directory.compare(0, root.size(), root) == 0) {
+                fs::remove_all(segment.directory);
+            }
+        }
+        LOG_INFO("Merged segments into " + merged.directory);
+        merges++;
+    }
+}
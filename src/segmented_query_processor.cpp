@@ -0,0 +1,389 @@
+#include "segmented_query_processor.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+SegmentedQueryProcessor::SegmentedQueryProcessor(const std::string &manifestFilename) : manifestFilename(manifestFilename) {
+    SegmentManifest manifest;
+    if (readManifest(manifestFilename, manifest) && !manifest.segments.empty()) {
+        std::cout << "Segments: " << manifest.segments.size() << " (generation " << manifest.generation << ")" << std::endl;
+        live = openGeneration(manifest.generation, manifest.segments, std::cout);
+    } else {
+        SegmentInfo base;
+        base.directory = SEGMENT_BASE_DIRECTORY;
+        live = openGeneration(-1, std::vector<SegmentInfo>{base}, std::cout);
+    }
+}
+
+SegmentedQueryProcessor::~SegmentedQueryProcessor() {
+    {
+        std::lock_guard<std::mutex> lock(reloaderMutex);
+        stopping = true;
+    }
+    reloaderWake.notify_all();
+    if (reloader.joinable()) {
+        reloader.join();
+    }
+}
+
+std::shared_ptr<SegmentedQueryProcessor::Generation> SegmentedQueryProcessor::openGeneration(int64_t number, const std::vector<SegmentInfo> &segments,
+                                                                                          std::ostream &messages) const {
+    std::shared_ptr<Generation> generation = std::make_shared<Generation>();
+    generation->number = number;
+    for (const SegmentInfo &info : segments) {
+        Segment segment;
+        segment.docBase = info.docBase;
+        segment.processor.reset(new QueryProcessor(segmentFile(info.directory, "index.bin"), segmentFile(info.directory, "lexicon.bin"),
+                                                   segmentFile(info.directory, "page_table.bin"), segmentFile(info.directory, "doc_lengths.bin"),
+                                                   messages));
+        generation->segments.push_back(std::move(segment));
+    }
+    applySettings(*generation);
+    return generation;
+}
+
+void SegmentedQueryProcessor::applySettings(Generation &generation) const {
+    // A single segment is searched through its own result cache, several through this one
+    size_t segmentCount = generation.segments.size();
+    size_t segmentResultBytes = segmentCount == 1 ? settings.resultCacheBytes : 0;
+    generation.resultCache.resize(segmentCount == 1 ? 0 : settings.resultCacheBytes);
+    for (Segment &segment : generation.segments) {
+        segment.processor->setTraversal(settings.traversal);
+        segment.processor->setBudget(settings.budget);
+        segment.processor->setTierMode(settings.tierMode);
+        segment.processor->setCacheSizes(segmentResultBytes, settings.blockCacheBytes / segmentCount);
+        segment.processor->setParallelism(settings.threads, settings.parallelMinPostings, rangePool);
+    }
+}
+
+// Score-at-a-time and approximate tier-1 answers need the segments' own IDFs, which a
+// query over several segments replaces with global ones (see searchTerms)
+void SegmentedQueryProcessor::warnIgnoredSettings(const Generation &generation) {
+    std::string ignored;
+    if (settings.traversal == TRAVERSAL_SAAT) ignored = "score-at-a-time traversal";
+    if (settings.tierMode == TIER_APPROXIMATE) ignored += std::string(ignored.empty() ? "" : " and ") + "approximate tier-1 answers";
+    if (ignored.empty() || warnedIgnoredSettings.exchange(true)) {
+        return;
+    }
+    std::string message = "Generation " + std::to_string(generation.number) + " has " + std::to_string(generation.segments.size()) +
+                          " segments: " + ignored + " ignored; OR queries over several segments run DAAT/TAAT without the side indexes";
+    std::cerr << message << std::endl;
+    LOG_WARN(message);
+}
+
+const SegmentedQueryProcessor::Segment &SegmentedQueryProcessor::Generation::segmentOf(int docID) const {
+    auto after = std::upper_bound(segments.begin(), segments.end(), static_cast<int64_t>(docID),
+                                  [](int64_t id, const Segment &segment) { return id < segment.docBase; });
+    return *(after - 1);
+}
+
+// Pack the terms, each followed by a 0 byte, into the key; false if they do not fit
+static bool segmentCacheKey(const std::string_view *terms, size_t termCount, SegmentResultCacheKey &key) {
+    char *bytes = reinterpret_cast<char *>(key.terms);
+    size_t length = 0;
+    for (size_t i = 0; i < termCount; ++i) {
+        if (length + terms[i].size() + 1 > sizeof(key.terms)) return false;
+        std::memcpy(bytes + length, terms[i].data(), terms[i].size());
+        length += terms[i].size() + 1;
+    }
+    return true;
+}
+
+size_t SegmentedQueryProcessor::search(std::string_view query, bool conjunctive, size_t k, SearchResult *results) {
+    rememberQuery(query, conjunctive);
+    std::shared_ptr<Generation> generation = current();
+    return search(*generation, query, conjunctive, k, results);
+}
+
+size_t SegmentedQueryProcessor::search(Generation &generation, std::string_view query, bool conjunctive, size_t k, SearchResult *results) {
+    std::vector<Segment> &segments = generation.segments;
+    if (segments.size() == 1) {
+        return segments[0].processor->search(query, conjunctive, k, results);
+    }
+
+    QueryArena &arena = QueryArena::local();
+    arena.reset();
+    std::string_view *terms;
+    size_t termCount = QueryProcessor::parseQuery(query, arena, terms);
+
+    // IDF from the document frequency over all segments
+    std::string_view *found = arena.allocateArray<std::string_view>(termCount);
+    float *termIDFs = arena.allocateArray<float>(termCount);
+    size_t foundCount = 0;
+    for (size_t i = 0; i < termCount; ++i) {
+        int64_t docFrequency = 0;
+        for (const Segment &segment : segments) {
+            docFrequency += segment.processor->getDocFrequency(terms[i]);
+        }
+        if (docFrequency == 0) {
+            if (!generation.warming) std::cout << "Term not found: " << terms[i] << std::endl;
+            continue;
+        }
+        found[foundCount] = terms[i];
+        termIDFs[foundCount++] = bm25IDF(IDF_TOTAL_DOCUMENTS, docFrequency);
+    }
+    if (foundCount == 0) {
+        return 0;
+    }
+
+    // Results under a time budget depend on the machine's load, so they are not cached
+    uint64_t version = 0;
+    for (const Segment &segment : segments) version += segment.processor->deletionsVersion();
+    SegmentResultCacheKey key = {};
+    bool cacheable = generation.resultCache.enabled() && k <= RESULT_CACHE_MAX_K && settings.budget.milliseconds <= 0 &&
+                     segmentCacheKey(found, foundCount, key);
+    if (cacheable) {
+        key.conjunctive = conjunctive;
+        key.k = static_cast<uint32_t>(k);
+        size_t resultCount = 0;
+        bool hit = false;
+        generation.resultCache.lookup(key, [&](const CachedResults &cached) {
+            if (cached.version != version) return;
+            std::copy(cached.results, cached.results + cached.count, results);
+            resultCount = cached.count;
+            hit = true;
+        });
+        if (hit) {
+            return resultCount;
+        }
+    }
+
+    if (!conjunctive && !generation.warming) {
+        warnIgnoredSettings(generation);
+    }
+    TopK topK(results, k);
+    SearchResult *partial = arena.allocateArray<SearchResult>(k);
+    for (const Segment &segment : segments) {
+        size_t count = segment.processor->searchTerms(found, termIDFs, foundCount, conjunctive, k, partial);
+        for (size_t i = 0; i < count; ++i) {
+            topK.push(static_cast<int>(partial[i].docID + segment.docBase), partial[i].score);
+        }
+    }
+    size_t resultCount = topK.finish();
+    if (cacheable) {
+        generation.resultCache.insert(key, [&](CachedResults &cached) {
+            cached.version = version;
+            std::copy(results, results + resultCount, cached.results);
+            cached.count = static_cast<uint32_t>(resultCount);
+        });
+    }
+    return resultCount;
+}
+
+void SegmentedQueryProcessor::processQuery(const std::string &query, bool conjunctive) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    // Results are named from the generation that found them
+    rememberQuery(query, conjunctive);
+    std::shared_ptr<Generation> generation = current();
+    const size_t resultsWanted = 10;
+    SearchResult results[resultsWanted];
+    size_t resultsCount = search(*generation, query, conjunctive, resultsWanted, results);
+    LOG_DEBUG(std::string(conjunctive ? "AND" : "OR") + " query \"" + query + "\": " + std::to_string(resultsCount) + " results in " +
+              std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - startTime).count()) +
+              " us (generation " + std::to_string(generation->number) + ")");
+
+    if (resultsCount == 0) {
+        std::cout << "No documents matched the query." << std::endl;
+        return;
+    }
+
+    // Display top 10 results
+    for (size_t i = 0; i < resultsCount; ++i) {
+        int docID = results[i].docID;
+        const Segment &segment = generation->segmentOf(docID);
+        char nameBuffer[16];
+        std::cout << i + 1 << ". DocID: " << docID << ", DocName: "
+                  << segment.processor->docName(static_cast<int>(docID - segment.docBase), nameBuffer)
+                  << ", Score: " << results[i].score << std::endl;
+    }
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout << "time passed: " << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << std::endl;
+}
+
+void SegmentedQueryProcessor::rememberQuery(std::string_view query, bool conjunctive) {
+    std::lock_guard<std::mutex> lock(recentMutex);
+    if (recentQueries.size() < RELOAD_WARMUP_QUERIES) {
+        recentQueries.emplace_back(std::string(query), conjunctive);
+        return;
+    }
+    // Assigning into the old strings reuses their storage
+    recentQueries[nextRecent].first.assign(query.data(), query.size());
+    recentQueries[nextRecent].second = conjunctive;
+    nextRecent = (nextRecent + 1) % RELOAD_WARMUP_QUERIES;
+}
+
+void SegmentedQueryProcessor::setWarmup(std::vector<std::string> terms, const WarmupBudget &budget) {
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    warmupTerms = std::move(terms);
+    warmupBudget = budget;
+}
+
+WarmupStats SegmentedQueryProcessor::warmUp() {
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    return warmUp(*current());
+}
+
+WarmupStats SegmentedQueryProcessor::warmUp(const Generation &generation) const {
+    WarmupStats stats;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    for (const std::string &term : warmupTerms) {
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+        if ((warmupBudget.bytes > 0 && stats.bytes >= warmupBudget.bytes) ||
+            (warmupBudget.milliseconds > 0 && elapsed >= warmupBudget.milliseconds)) {
+            stats.complete = false;
+            break;
+        }
+        size_t termBytes = 0;
+        for (const Segment &segment : generation.segments) {
+            termBytes += segment.processor->prefetchTerm(term);
+        }
+        stats.terms += termBytes > 0;
+        stats.bytes += termBytes;
+    }
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+    return stats;
+}
+
+bool SegmentedQueryProcessor::reload() {
+    std::unique_lock<std::mutex> lock(reloadMutex);
+    SegmentManifest manifest;
+    if (!readManifest(manifestFilename, manifest) || manifest.segments.empty() ||
+        manifest.generation == current()->number || manifest.generation == failedGeneration) {
+        return false;
+    }
+
+    // Open and check the new segments while the current ones keep serving; stdout carries
+    // the query results, so this thread reports on stderr
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::shared_ptr<Generation> next = openGeneration(manifest.generation, manifest.segments, std::cerr);
+    for (const Segment &segment : next->segments) {
+        if (!segment.processor->isOpen()) {
+            std::cerr << "Could not open generation " << manifest.generation << "; still serving generation "
+                      << current()->number << std::endl;
+            LOG_ERROR("Could not open generation " + std::to_string(manifest.generation));
+            failedGeneration = manifest.generation;
+            return false;
+        }
+    }
+
+    // Warm the new segments' pages and caches with the frequent terms and what is being asked, quietly
+    WarmupStats warmed = warmUp(*next);
+    std::vector<std::pair<std::string, bool>> warmup;
+    {
+        std::lock_guard<std::mutex> recentLock(recentMutex);
+        warmup = recentQueries;
+    }
+    next->warming = true;
+    for (Segment &segment : next->segments) segment.processor->setReportMissingTerms(false);
+    SearchResult results[RESULT_CACHE_MAX_K];
+    for (const auto &[query, conjunctive] : warmup) {
+        search(*next, query, conjunctive, RESULT_CACHE_MAX_K, results);
+    }
+    for (Segment &segment : next->segments) segment.processor->setReportMissingTerms(true);
+    next->warming = false;
+
+    // Queries already running hold their own reference to the old generation; once the
+    // last of them is done, it is closed here rather than on a query thread. The wait is
+    // outside the lock, so a long query holds up neither the setters nor the next reload.
+    std::shared_ptr<Generation> previous = std::atomic_exchange(&live, next);
+    lock.unlock();
+    while (previous.use_count() > 1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    int64_t previousNumber = previous->number;
+    previous.reset();
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::cerr << "Generation " << manifest.generation << " live (" << manifest.segments.size() << " segments, "
+              << warmed.bytes / 1024 << " KB of lists read in, " << warmup.size() << " warm-up queries, "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count()
+              << " ms); generation " << previousNumber << " closed" << std::endl;
+    LOG_INFO("Generation " + std::to_string(manifest.generation) + " live with " + std::to_string(manifest.segments.size()) +
+             " segments after " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count()) +
+             " ms; generation " + std::to_string(previousNumber) + " closed");
+    return true;
+}
+
+void SegmentedQueryProcessor::startReloading(int pollMilliseconds) {
+    if (reloader.joinable() || pollMilliseconds <= 0) {
+        return;
+    }
+    reloader = std::thread([this, pollMilliseconds] {
+        std::unique_lock<std::mutex> lock(reloaderMutex);
+        while (!reloaderWake.wait_for(lock, std::chrono::milliseconds(pollMilliseconds), [this] { return stopping; })) {
+            lock.unlock();
+            reload();
+            lock.lock();
+        }
+    });
+}
+
+void SegmentedQueryProcessor::setTraversal(Traversal mode) {
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    settings.traversal = mode;
+    current()->resultCache.clear();
+    for (Segment &segment : current()->segments) segment.processor->setTraversal(mode);
+}
+
+void SegmentedQueryProcessor::setBudget(const QueryBudget &limits) {
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    settings.budget = limits;
+    current()->resultCache.clear();
+    for (Segment &segment : current()->segments) segment.processor->setBudget(limits);
+}
+
+void SegmentedQueryProcessor::setTierMode(TierMode mode) {
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    settings.tierMode = mode;
+    current()->resultCache.clear();
+    for (Segment &segment : current()->segments) segment.processor->setTierMode(mode);
+}
+
+void SegmentedQueryProcessor::setCacheSizes(size_t resultBytes, size_t blockBytes) {
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    settings.resultCacheBytes = resultBytes;
+    settings.blockCacheBytes = blockBytes;
+    applySettings(*current());
+}
+
+void SegmentedQueryProcessor::setParallelism(size_t threads, int64_t minPostings) {
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    settings.threads = threads;
+    settings.parallelMinPostings = minPostings;
+    // Queries still running keep the previous pool through their segments
+    rangePool = threads > 1 ? std::make_shared<ThreadPool>(threads - 1) : nullptr;
+    for (Segment &segment : current()->segments) segment.processor->setParallelism(threads, minPostings, rangePool);
+}
+
+bool SegmentedQueryProcessor::hasImpactIndex() const {
+    std::shared_ptr<Generation> generation = current();
+    return std::any_of(generation->segments.begin(), generation->segments.end(),
+                       [](const Segment &segment) { return segment.processor->hasImpactIndex(); });
+}
+
+size_t SegmentedQueryProcessor::segmentCount() const {
+    return current()->segments.size();
+}
+
+static void addStats(CacheStats &total, const CacheStats &stats) {
+    total.hits += stats.hits;
+    total.misses += stats.misses;
+    total.admitted += stats.admitted;
+    total.rejected += stats.rejected;
+}
+
+CacheStats SegmentedQueryProcessor::resultCacheStats() {
+    std::shared_ptr<Generation> generation = current();
+    CacheStats total = generation->resultCache.stats();
+    for (Segment &segment : generation->segments) addStats(total, segment.processor->resultCacheStats());
+    return total;
+}
+
+CacheStats SegmentedQueryProcessor::blockCacheStats() {
+    CacheStats total;
+    for (Segment &segment : current()->segments) addStats(total, segment.processor->blockCacheStats());
+    return total;
+}
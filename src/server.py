@@ -3,7 +3,6 @@ import subprocess
 import threading
 import queue
 import sys
-import time
 import os
 
 app = Flask(__name__, static_folder='static')
@@ -20,13 +19,21 @@ def start_query_processor():
             ['../build/query_processor'],
             stdin=subprocess.PIPE,
             stdout=subprocess.PIPE,
-            stderr=subprocess.PIPE,
+            stderr=None,  # Load and reload messages go straight to our stderr
             text=True,
             bufsize=1,
             env={**os.environ, "PYTHONUNBUFFERED": "1"}
         )
         print("Waiting for query processor to initialize...", file=sys.stderr)
-        time.sleep(20)  # Wait for the query processor to start
+        # The index is loaded once the welcome line is printed; new index generations
+        # are swapped in by the query processor itself, so this happens only once
+        while True:
+            line = process.stdout.readline()
+            if not line:
+                print("Query processor exited during startup.", file=sys.stderr)
+                sys.exit(1)
+            if "Welcome to the Query Processor!" in line:
+                break
         print("Query processor ready.", file=sys.stderr)
 
         # Start the background thread to read from the process
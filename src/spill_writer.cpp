@@ -0,0 +1,221 @@
+#include "spill_writer.h"
+#include "file_write_buffer.h"
+#include "logger.h"
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#define SPILL_WRITE_CHUNK 8000000 // Write 8MB at a time
+
+// --- Parallel radix sort ---
+
+void parallelRadixSort(std::vector<SpillRecord> &records, std::vector<SpillRecord> &scratch, size_t threads)
+{
+    size_t n = records.size();
+    if (n < 2)
+        return;
+    threads = std::max<size_t>(1, std::min(threads, n / 65536 + 1));
+    scratch.resize(n);
+
+    uint64_t maxKey = 0;
+    for (const auto &record : records)
+        maxKey = std::max(maxKey, record.key);
+    int passes = 0;
+    while (passes < 8 && (maxKey >> (passes * 8)) != 0)
+        passes++;
+
+    SpillRecord *src = records.data();
+    SpillRecord *dst = scratch.data();
+    size_t chunk = (n + threads - 1) / threads;
+    std::vector<std::array<size_t, 256>> histograms(threads);
+
+    for (int pass = 0; pass < passes; ++pass)
+    {
+        int shift = pass * 8;
+
+        // Count digits per chunk
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t]
+                                 {
+                auto &hist = histograms[t];
+                hist.fill(0);
+                size_t begin = std::min(n, t * chunk), end = std::min(n, begin + chunk);
+                for (size_t i = begin; i < end; ++i)
+                    hist[(src[i].key >> shift) & 0xFF]++; });
+        }
+        for (auto &worker : workers)
+            worker.join();
+
+        // Skip passes where every key has the same digit (e.g. unused high docID bytes)
+        size_t total = 0;
+        bool constantDigit = false;
+        for (int d = 0; d < 256 && !constantDigit; ++d)
+        {
+            total = 0;
+            for (size_t t = 0; t < threads; ++t)
+                total += histograms[t][d];
+            constantDigit = total == n;
+        }
+        if (constantDigit)
+            continue;
+
+        // Turn counts into per-chunk output positions
+        size_t running = 0;
+        for (int d = 0; d < 256; ++d)
+        {
+            for (size_t t = 0; t < threads; ++t)
+            {
+                size_t count = histograms[t][d];
+                histograms[t][d] = running;
+                running += count;
+            }
+        }
+
+        // Scatter, keeping chunk order so each pass stays stable
+        workers.clear();
+        for (size_t t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t]
+                                 {
+                auto &pos = histograms[t];
+                size_t begin = std::min(n, t * chunk), end = std::min(n, begin + chunk);
+                for (size_t i = begin; i < end; ++i)
+                    dst[pos[(src[i].key >> shift) & 0xFF]++] = src[i]; });
+        }
+        for (auto &worker : workers)
+            worker.join();
+        std::swap(src, dst);
+    }
+
+    if (src != records.data())
+        records.swap(scratch);
+}
+
+// --- SpillWriter Implementation ---
+
+SpillWriter::SpillWriter(size_t sortThreads, const std::string &runDirectory)
+    : sortThreads(sortThreads), runDirectory(runDirectory), pendingFileCounter(0), hasPending(false), stop(false)
+{
+    spillThread = std::thread([this]
+                              { run(); });
+}
+
+SpillWriter::~SpillWriter()
+{
+    finish();
+}
+
+void SpillWriter::submit(std::vector<TermDocPair> &buffer, int fileCounter)
+{
+    {
+        std::unique_lock<std::mutex> lock(spillMutex);
+        // The only time parsing waits: the previous run is still being written
+        spillDone.wait(lock, [this]
+                       { return !hasPending; });
+        pending.swap(buffer);
+        pendingFileCounter = fileCounter;
+        hasPending = true;
+    }
+    spillQueued.notify_one();
+}
+
+void SpillWriter::finish()
+{
+    {
+        std::unique_lock<std::mutex> lock(spillMutex);
+        if (stop)
+            return;
+        stop = true;
+    }
+    spillQueued.notify_one();
+    spillThread.join();
+}
+
+void SpillWriter::run()
+{
+    while (true)
+    {
+        int fileCounter;
+        {
+            std::unique_lock<std::mutex> lock(spillMutex);
+            spillQueued.wait(lock, [this]
+                             { return hasPending || stop; });
+            if (!hasPending)
+                return;
+            fileCounter = pendingFileCounter;
+        }
+
+        // Submitters wait on hasPending, so the buffer is ours until we clear it
+        spill(pending, fileCounter);
+        pending.clear();
+
+        {
+            std::unique_lock<std::mutex> lock(spillMutex);
+            hasPending = false;
+        }
+        spillDone.notify_all();
+    }
+}
+
+// Sort term-docID pairs by (term, docID) and write them to a temp file
+void SpillWriter::spill(const std::vector<TermDocPair> &termDocPairs, int fileCounter)
+{
+    // Assign local term ids, then ranks in lexicographic order
+    std::unordered_map<std::string_view, uint32_t> termIds;
+    std::vector<std::string_view> terms;
+    termIds.reserve(termDocPairs.size() / 4);
+    records.resize(termDocPairs.size());
+    for (size_t i = 0; i < termDocPairs.size(); ++i)
+    {
+        auto [it, inserted] = termIds.emplace(termDocPairs[i].term, static_cast<uint32_t>(terms.size()));
+        if (inserted)
+            terms.push_back(termDocPairs[i].term);
+        records[i].key = it->second;
+    }
+
+    std::vector<uint32_t> order(terms.size());
+    for (uint32_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&terms](uint32_t a, uint32_t b)
+              { return terms[a] < terms[b]; });
+    std::vector<uint32_t> rank(terms.size());
+    for (uint32_t r = 0; r < order.size(); ++r)
+        rank[order[r]] = r;
+
+    // Pack (term rank, docID) into one integer key
+    for (size_t i = 0; i < termDocPairs.size(); ++i)
+    {
+        records[i].key = (static_cast<uint64_t>(rank[records[i].key]) << 32) | static_cast<uint32_t>(termDocPairs[i].docID);
+        records[i].termFScore = termDocPairs[i].termFScore;
+    }
+
+    parallelRadixSort(records, scratch, sortThreads);
+
+    std::string tempFileName = runDirectory + "/temp" + std::to_string(fileCounter) + ".bin";
+    try
+    {
+        WriteFileBuffer tempFile(tempFileName, SPILL_WRITE_CHUNK);
+        for (const auto &record : records)
+        {
+            std::string_view term = terms[order[record.key >> 32]];
+            int docID = static_cast<int>(record.key & 0xFFFFFFFF);
+            uint16_t termLength = static_cast<uint16_t>(term.length());
+            tempFile.write(reinterpret_cast<const char *>(&termLength), sizeof(termLength));
+            tempFile.write(term.data(), termLength);
+            tempFile.write(reinterpret_cast<const char *>(&docID), sizeof(docID));
+            tempFile.write(reinterpret_cast<const char *>(&record.termFScore), sizeof(record.termFScore));
+        }
+    }
+    catch (const std::runtime_error &e)
+    {
+        LOG_ERROR(e.what());
+        return;
+    }
+    LOG_INFO("Saved term-docID pairs to temp file " + tempFileName);
+}
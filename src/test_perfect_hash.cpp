@@ -0,0 +1,56 @@
+// Checks that the perfect hash builds on real vocabularies within the first seeds and maps
+// every term to its own index. Takes the terms from the lexicon in ../data like the other
+// test tools.
+#include "lexicon.h"
+#include "perfect_hash.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+const uint64_t MAX_EXPECTED_SEED = 2;
+
+int main() {
+    Lexicon lexicon;
+    if (!lexicon.open("../data/lexicon.bin") || lexicon.size() < 5002) {
+        std::cerr << "Need a built index in ../data" << std::endl;
+        return 1;
+    }
+    std::vector<std::string> terms(lexicon.size());
+    for (uint32_t i = 0; i < lexicon.size(); ++i) {
+        terms[i] = lexicon.term(i);
+    }
+
+    const std::string filename = "../data/intermediate/test_mph.bin";
+    bool failed = false;
+    for (size_t keyCount : {size_t(1000), size_t(5002), terms.size()}) {
+        std::vector<std::string_view> keys(terms.begin(), terms.begin() + keyCount);
+        auto startTime = std::chrono::high_resolution_clock::now();
+        PerfectHash hash;
+        if (!buildPerfectHash(keys, filename) || !hash.open(filename)) {
+            std::cout << "FAIL: no perfect hash for " << keyCount << " terms" << std::endl;
+            failed = true;
+            continue;
+        }
+        auto endTime = std::chrono::high_resolution_clock::now();
+
+        size_t wrong = 0;
+        for (size_t i = 0; i < keyCount; ++i) {
+            wrong += hash.find(keys[i]) != static_cast<int64_t>(i);
+        }
+        std::cout << keyCount << " terms: seed " << hash.seed() << ", "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << " ms, "
+                  << wrong << " wrong lookups" << std::endl;
+        if (hash.seed() > MAX_EXPECTED_SEED || wrong > 0) {
+            std::cout << "FAIL: " << keyCount << " terms" << std::endl;
+            failed = true;
+        }
+    }
+    std::remove(filename.c_str());
+    if (failed) {
+        return 1;
+    }
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
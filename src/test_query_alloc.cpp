@@ -0,0 +1,90 @@
+// Checks that the query hot path does not allocate once the per-thread arena is warm.
+// Runs against the index in ../data like the other test tools.
+#include "query_processor.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+static std::atomic<size_t> allocationCount{0};
+
+void *operator new(std::size_t size) {
+    allocationCount++;
+    if (void *ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+int main() {
+    QueryProcessor qp("../data/index.bin", "../data/lexicon.bin", "../data/page_table.bin", "../data/doc_lengths.bin");
+
+    // Pick the most frequent terms so the lists span many blocks
+    Lexicon lexicon;
+    if (!lexicon.open("../data/lexicon.bin") || lexicon.size() < 4) {
+        std::cerr << "Need a built index in ../data" << std::endl;
+        return 1;
+    }
+    std::vector<std::pair<int, uint32_t>> byFrequency;
+    for (uint32_t i = 0; i < lexicon.size(); ++i) {
+        byFrequency.emplace_back(lexicon.record(i).docFrequency, i);
+    }
+    std::sort(byFrequency.rbegin(), byFrequency.rend());
+    std::vector<std::string> queries = {
+        lexicon.term(byFrequency[0].second) + " " + lexicon.term(byFrequency[1].second),
+        lexicon.term(byFrequency[0].second) + " " + lexicon.term(byFrequency[2].second) + " " + lexicon.term(byFrequency[3].second),
+        lexicon.term(byFrequency[byFrequency.size() / 2].second) + " " + lexicon.term(byFrequency[1].second),
+    };
+
+    // Evaluation first, with both caches off, so every query runs its cursors; then with
+    // the block cache, and with both caches, where repeated queries are answered from them
+    struct Pass {
+        const char *name;
+        size_t resultBytes, blockBytes;
+    };
+    const Pass passes[] = {
+        {"uncached", 0, 0},
+        {"block cache", 0, BLOCK_CACHE_BYTES},
+        {"result and block cache", RESULT_CACHE_BYTES, BLOCK_CACHE_BYTES},
+    };
+    SearchResult results[10];
+    bool failed = false;
+    for (const Pass &pass : passes) {
+        qp.setCacheSizes(pass.resultBytes, pass.blockBytes);
+        // Warm up: the first queries grow the arena and fill the caches
+        for (const auto &query : queries) {
+            qp.search(query, false, 10, results);
+            qp.search(query, true, 10, results);
+        }
+
+        size_t before = allocationCount.load();
+        size_t totalResults = 0;
+        for (int round = 0; round < 100; ++round) {
+            for (const auto &query : queries) {
+                totalResults += qp.search(query, false, 10, results);
+                totalResults += qp.search(query, true, 10, results);
+            }
+        }
+        size_t allocations = allocationCount.load() - before;
+
+        std::cout << pass.name << ": queries: " << 100 * queries.size() * 2 << ", results: " << totalResults
+                  << ", heap allocations: " << allocations << std::endl;
+        if (allocations != 0) {
+            std::cout << "FAIL: query path allocated (" << pass.name << ")" << std::endl;
+            failed = true;
+        }
+    }
+    if (failed) {
+        return 1;
+    }
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
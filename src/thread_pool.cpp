@@ -1,22 +1,58 @@
 // thread_pool.cpp
 #include "thread_pool.h"
-#include <iostream>
+#include <algorithm>
+
+// Pool and deque of the worker running on this thread, if any
+static thread_local ThreadPool *currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+void TaskGroup::finishTask()
+{
+    // Counted down under the lock, so wait() cannot return (and the group go away)
+    // while the last task is still signalling
+    std::lock_guard<std::mutex> lock(doneMutex);
+    if (--pending == 0)
+    {
+        done.notify_all();
+    }
+}
+
+void TaskGroup::wait()
+{
+    // Help with the group's own queued work rather than block
+    ThreadPool *owner = pool.load();
+    while (pending.load() > 0 && owner && owner->runPendingTask(this))
+    {
+    }
+    std::unique_lock<std::mutex> lock(doneMutex);
+    done.wait(lock, [this]
+              { return pending.load() == 0; });
+}
 
 ThreadPool::ThreadPool(size_t threads, size_t maxThreadsInQueue)
-    : stop(false), maxThreadsInQueue(maxThreadsInQueue), tasksRemaining(0)
+    : maxThreadsInQueue(maxThreadsInQueue)
 {
+    if (threads == 0)
+    {
+        threads = 1;
+    }
     for (size_t i = 0; i < threads; ++i)
     {
-        workers.emplace_back([this]
-                             { worker(); });
+        queues.emplace_back(new WorkQueue());
+    }
+    for (size_t i = 0; i < threads; ++i)
+    {
+        workers.emplace_back([this, i]
+                             { worker(i); });
     }
 }
 
 ThreadPool::~ThreadPool()
 {
+    // Workers drain the deques before they exit
+    stop = true;
     {
-        std::unique_lock<std::mutex> lock(queueMutex);
-        stop = true;
+        std::lock_guard<std::mutex> lock(sleepMutex);
     }
     taskAvailable.notify_all();
     for (std::thread &worker : workers)
@@ -25,52 +61,164 @@ ThreadPool::~ThreadPool()
     }
 }
 
-void ThreadPool::enqueue(std::function<void()> f)
+size_t ThreadPool::targetQueue()
 {
+    return currentPool == this ? currentWorker : nextQueue++ % queues.size();
+}
+
+void ThreadPool::wakeWorkers(size_t count)
+{
+    // A worker counts itself as sleeping before it checks queued, so one of the two sides
+    // always sees the other and no wakeup is lost
+    if (sleeping.load() == 0)
     {
-        std::unique_lock<std::mutex> lock(queueMutex);
-        // Wait if the queue is full
-        while (tasks.size() >= maxThreadsInQueue) {
-            spaceAvailable.wait(lock);
-        }
-        tasks.emplace(std::move(f));
-        ++tasksRemaining;  // Increment tasks remaining
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    if (count == 1)
+    {
+        taskAvailable.notify_one();
+    }
+    else
+    {
+        taskAvailable.notify_all();
     }
-    taskAvailable.notify_one();
 }
 
-void ThreadPool::worker()
+void ThreadPool::push(size_t queue, Task task)
 {
-    while (true)
     {
-        std::function<void()> task;
+        // Counted before it is visible, so a thief's --queued never takes the count below zero
+        std::lock_guard<std::mutex> lock(queues[queue]->lock);
+        ++queued;
+        queues[queue]->tasks.push_back(std::move(task));
+    }
+    wakeWorkers(1);
+}
+
+void ThreadPool::submit(TaskGroup &group, std::function<void()> f)
+{
+    group.pool = this;
+    ++group.pending;
+    // Backpressure: a submitter that outpaces the workers runs tasks of its group itself
+    while (queued.load() >= maxThreadsInQueue && runPendingTask(&group))
+    {
+    }
+    push(targetQueue(), Task{std::move(f), &group});
+}
+
+void ThreadPool::submitBatch(TaskGroup &group, std::vector<std::function<void()>> &tasks)
+{
+    if (tasks.empty())
+    {
+        return;
+    }
+    group.pool = this;
+    group.pending += tasks.size();
+    size_t first = targetQueue();
+    for (size_t q = 0; q < queues.size() && q < tasks.size(); ++q)
+    {
+        WorkQueue &queue = *queues[(first + q) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        queued += (tasks.size() - q + queues.size() - 1) / queues.size();
+        for (size_t i = q; i < tasks.size(); i += queues.size())
         {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            taskAvailable.wait(lock, [this]
-                               { return stop || !tasks.empty(); });
-            if (stop && tasks.empty())
-                return;
-
-            task = std::move(tasks.front());
-            tasks.pop();
-            spaceAvailable.notify_one();
+            queue.tasks.push_back(Task{std::move(tasks[i]), &group});
         }
-        // Execute the task outside the lock
-        task();
+    }
+    wakeWorkers(tasks.size());
+    tasks.clear();
+}
+
+void ThreadPool::enqueue(std::function<void()> f)
+{
+    submit(defaultGroup, std::move(f));
+}
 
-        // Decrement tasks remaining and notify if zero
+void ThreadPool::waitAll()
+{
+    defaultGroup.wait();
+}
+
+// Take a task: the newest of the worker's own deque, else the oldest of another one.
+// With a group, only that group's tasks are taken.
+bool ThreadPool::popTask(size_t index, Task &task, const TaskGroup *group)
+{
+    bool own = currentPool == this && index == currentWorker;
+    for (size_t i = 0; i < queues.size(); ++i)
+    {
+        WorkQueue &queue = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        if (queue.tasks.empty())
+        {
+            continue;
+        }
+        if (group)
         {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            if (--tasksRemaining == 0) {
-                allTasksDone.notify_all();
+            auto match = std::find_if(queue.tasks.begin(), queue.tasks.end(), [group](const Task &queuedTask)
+                                      { return queuedTask.group == group; });
+            if (match == queue.tasks.end())
+            {
+                continue;
             }
+            task = std::move(*match);
+            queue.tasks.erase(match);
+        }
+        else if (i == 0 && own)
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
         }
+        --queued;
+        return true;
     }
+    return false;
 }
 
-void ThreadPool::waitAll()
+void ThreadPool::execute(Task &task)
+{
+    task.run();
+    task.group->finishTask();
+}
+
+bool ThreadPool::runPendingTask(const TaskGroup *group)
+{
+    Task task;
+    size_t start = currentPool == this ? currentWorker : nextQueue.load() % queues.size();
+    if (!popTask(start, task, group))
+    {
+        return false;
+    }
+    execute(task);
+    return true;
+}
+
+void ThreadPool::worker(size_t index)
 {
-    std::unique_lock<std::mutex> lock(queueMutex);
-    allTasksDone.wait(lock, [this]
-                      { return tasksRemaining == 0; });
+    currentPool = this;
+    currentWorker = index;
+    while (true)
+    {
+        Task task;
+        if (popTask(index, task))
+        {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        ++sleeping;
+        taskAvailable.wait(lock, [this]
+                           { return stop || queued.load() > 0; });
+        --sleeping;
+        if (stop && queued.load() == 0)
+            return;
+    }
 }
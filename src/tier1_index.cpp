@@ -0,0 +1,122 @@
+#include "tier1_index.h"
+#include "file_write_buffer.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#define TIER1_WRITE_CHUNK 40000000 // Write 40MB at a time
+
+std::string tier1IndexFilename(const std::string &indexFilename) {
+    size_t slash = indexFilename.find_last_of('/');
+    size_t nameStart = slash == std::string::npos ? 0 : slash + 1;
+    return indexFilename.substr(0, nameStart) + "tier1_" + indexFilename.substr(nameStart);
+}
+
+bool buildTier1Index(const std::string &indexFilename, const std::string &lexiconFilename,
+                     const std::string &outputFilename, uint32_t postingsPerTerm) {
+    InvertedIndex index(indexFilename, lexiconFilename);
+    Lexicon lexicon;
+    if (!lexicon.open(lexiconFilename) || postingsPerTerm == 0) {
+        return false;
+    }
+    std::vector<int> docBuffer(MAX_BLOCK_POSTINGS);
+
+    WriteFileBuffer output(outputFilename, TIER1_WRITE_CHUNK);
+    std::vector<LexiconRecord> records(lexicon.size());
+    std::vector<float> residuals(lexicon.size(), 0);
+    std::vector<std::pair<int, float>> postings;
+    std::vector<unsigned char> encodedList;
+    uint64_t written = 0;
+    for (uint32_t term = 0; term < lexicon.size(); ++term) {
+        InvertedListPointer cursor = index.openList(term, docBuffer.data());
+        postings.clear();
+        while (cursor.next()) {
+            postings.emplace_back(cursor.getDocID(), cursor.getTFS());
+        }
+
+        // Keep the best postings (IDF is the same for the whole list, so rank by score);
+        // the best one left out bounds everything the tier does not have
+        if (postings.size() > postingsPerTerm) {
+            auto better = [](const std::pair<int, float> &a, const std::pair<int, float> &b) {
+                return a.second != b.second ? a.second > b.second : a.first < b.first;
+            };
+            std::nth_element(postings.begin(), postings.begin() + postingsPerTerm, postings.end(), better);
+            float bestLeftOut = std::max_element(postings.begin() + postingsPerTerm, postings.end(),
+                                                 [](const std::pair<int, float> &a, const std::pair<int, float> &b) {
+                                                     return a.second < b.second;
+                                                 })->second;
+            residuals[term] = std::max(0.0f, lexicon.record(term).IDF * bestLeftOut);
+            postings.resize(postingsPerTerm);
+            std::sort(postings.begin(), postings.end());
+        }
+
+        LexiconRecord record = {};
+        record.offset = static_cast<int64_t>(written);
+        record.docFrequency = static_cast<int32_t>(postings.size());
+        record.IDF = lexicon.record(term).IDF;
+        record.encoding = LIST_ENCODING_BLOCKS;
+        if (!postings.empty()) {
+            record.blockCount = encodePostingList(postings, encodedList);
+            record.length = static_cast<int32_t>(encodedList.size());
+            output.write(reinterpret_cast<const char *>(encodedList.data()), encodedList.size());
+            written += encodedList.size();
+        }
+        records[term] = record;
+    }
+
+    static const char zeros[8] = {0};
+    size_t padding = (8 - written % 8) % 8;
+    output.write(zeros, padding);
+    written += padding;
+
+    Tier1Footer footer = {};
+    footer.magic = TIER1_MAGIC;
+    footer.termCount = lexicon.size();
+    footer.recordOffset = written;
+    footer.residualOffset = written + records.size() * sizeof(LexiconRecord);
+    footer.postingsPerTerm = postingsPerTerm;
+    output.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(LexiconRecord));
+    output.write(reinterpret_cast<const char *>(residuals.data()), residuals.size() * sizeof(float));
+    output.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+    std::cout << "Tier-1 index written to " << outputFilename << " (" << postingsPerTerm
+              << " postings per term, " << footer.residualOffset + residuals.size() * sizeof(float) + sizeof(footer)
+              << " bytes)." << std::endl;
+    return true;
+}
+
+// --- Tier1Index ---
+
+bool Tier1Index::open(const std::string &filename) {
+    data.clear();
+    std::ifstream input(filename, std::ios::binary | std::ios::ate);
+    if (!input.is_open()) {
+        return false;
+    }
+    std::vector<unsigned char> contents(static_cast<size_t>(input.tellg()));
+    input.seekg(0);
+    if (contents.size() < sizeof(Tier1Footer) ||
+        !input.read(reinterpret_cast<char *>(contents.data()), contents.size())) {
+        std::cerr << "Truncated tier-1 index: " << filename << std::endl;
+        return false;
+    }
+
+    std::memcpy(&footer, contents.data() + contents.size() - sizeof(Tier1Footer), sizeof(Tier1Footer));
+    if (footer.magic != TIER1_MAGIC ||
+        footer.residualOffset + footer.termCount * sizeof(float) > contents.size() - sizeof(Tier1Footer)) {
+        std::cerr << "Invalid tier-1 index (rebuild it): " << filename << std::endl;
+        return false;
+    }
+    data = std::move(contents);
+    records = reinterpret_cast<const LexiconRecord *>(data.data() + footer.recordOffset);
+    residuals = reinterpret_cast<const float *>(data.data() + footer.residualOffset);
+    return true;
+}
+
+InvertedListPointer Tier1Index::openList(uint32_t termIndex, int *docBuffer) const {
+    const LexiconRecord &record = records[termIndex];
+    if (record.docFrequency == 0) {
+        return InvertedListPointer();
+    }
+    return InvertedListPointer(data.data() + record.offset, &record, docBuffer);
+}
@@ -0,0 +1,141 @@
+#include "tombstones.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static size_t bitmapWords(uint64_t docCount) {
+    return (docCount + 63) / 64;
+}
+
+std::string tombstonesFilename(const std::string &indexFilename) {
+    size_t slash = indexFilename.find_last_of('/');
+    size_t nameStart = slash == std::string::npos ? 0 : slash + 1;
+    return indexFilename.substr(0, nameStart) + "tombstones.bin";
+}
+
+bool writeTombstones(const std::string &filename, uint64_t docCount, const uint64_t *words) {
+    std::vector<uint64_t> bitmap(bitmapWords(docCount), 0);
+    TombstonesHeader header = {TOMBSTONES_MAGIC, 0, docCount, 0, 0};
+    if (words) {
+        for (size_t i = 0; i < bitmap.size(); ++i) {
+            bitmap[i] = words[i];
+            header.deletedCount += __builtin_popcountll(words[i]);
+        }
+    }
+
+    // Written aside and renamed, so a mapping of the previous file is never cut short
+    std::string temporary = filename + ".tmp";
+    {
+        std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+        if (!output) {
+            std::cerr << "Error opening tombstones file: " << temporary << std::endl;
+            return false;
+        }
+        output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char *>(bitmap.data()), bitmap.size() * sizeof(uint64_t));
+        if (!output.flush()) {
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+int64_t deleteDocuments(const std::string &filename, const int *docIDs, size_t count,
+                        const std::function<bool()> &stillListed) {
+    int fd = ::open(filename.c_str(), O_RDWR);
+    if (fd < 0) {
+        // A merge removes its inputs once the manifest lists the merged segment
+        if (stillListed && !stillListed()) {
+            return TOMBSTONES_MOVED;
+        }
+        std::cerr << "Error opening tombstones file: " << filename << std::endl;
+        return -1;
+    }
+    flock(fd, LOCK_EX);
+    if (stillListed && !stillListed()) {
+        ::close(fd);
+        return TOMBSTONES_MOVED;
+    }
+
+    struct stat info;
+    void *addr = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(TombstonesHeader)) {
+        addr = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    TombstonesHeader *header = static_cast<TombstonesHeader *>(addr);
+    if (addr == MAP_FAILED || header->magic != TOMBSTONES_MAGIC ||
+        static_cast<size_t>(info.st_size) < sizeof(TombstonesHeader) + bitmapWords(header->docCount) * sizeof(uint64_t)) {
+        std::cerr << "Invalid tombstones file: " << filename << std::endl;
+        if (addr != MAP_FAILED) munmap(addr, info.st_size);
+        ::close(fd);
+        return -1;
+    }
+
+    // Bits first, then the counters readers check before looking at the bits
+    uint64_t *words = reinterpret_cast<uint64_t *>(header + 1);
+    int64_t deleted = 0;
+    for (size_t i = 0; i < count; ++i) {
+        int docID = docIDs[i];
+        if (docID < 0 || static_cast<uint64_t>(docID) >= header->docCount) {
+            std::cerr << "DocID " << docID << " is out of range for " << filename << std::endl;
+            continue;
+        }
+        uint64_t bit = uint64_t(1) << (docID & 63);
+        if (!(__atomic_fetch_or(&words[docID >> 6], bit, __ATOMIC_RELAXED) & bit)) {
+            deleted++;
+        }
+    }
+    if (deleted > 0) {
+        __atomic_fetch_add(&header->deletedCount, deleted, __ATOMIC_RELEASE);
+        __atomic_fetch_add(&header->version, 1, __ATOMIC_RELEASE);
+        msync(addr, info.st_size, MS_SYNC);
+    }
+    munmap(addr, info.st_size);
+    ::close(fd);  // Releases the lock
+    return deleted;
+}
+
+// --- TombstonesLocks ---
+
+bool TombstonesLocks::lock(const std::string &filename) {
+    int fd = ::open(filename.c_str(), O_RDWR);
+    if (fd < 0) {
+        std::cerr << "Error opening tombstones file: " << filename << std::endl;
+        return false;
+    }
+    flock(fd, LOCK_EX);
+    fds.push_back(fd);
+    return true;
+}
+
+void TombstonesLocks::unlock() {
+    for (int fd : fds) {
+        ::close(fd);
+    }
+    fds.clear();
+}
+
+// --- Tombstones ---
+
+bool Tombstones::open(const std::string &filename) {
+    close();
+    if (!file.open(filename)) {
+        return false;
+    }
+    const TombstonesHeader *fileHeader = reinterpret_cast<const TombstonesHeader *>(file.data());
+    if (file.size() < sizeof(TombstonesHeader) || fileHeader->magic != TOMBSTONES_MAGIC ||
+        file.size() < sizeof(TombstonesHeader) + bitmapWords(fileHeader->docCount) * sizeof(uint64_t)) {
+        std::cerr << "Invalid tombstones file: " << filename << std::endl;
+        file.close();
+        return false;
+    }
+    header = fileHeader;
+    words = reinterpret_cast<const uint64_t *>(file.data() + sizeof(TombstonesHeader));
+    return true;
+}
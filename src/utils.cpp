@@ -1,4 +1,6 @@
 #include "utils.h"
+#include "doc_tables.h"
+#include "logger.h"
 #include <sys/stat.h>
 #include <iostream>
 
@@ -8,6 +10,7 @@
 #include <sstream>
 
 #include <cstdint>
+#include <climits>
 
 
 
@@ -18,12 +21,16 @@
     #include <sys/stat.h>  // For mkdir on Unix
 #endif
 
-// Helper function to create directories for data 
+// Helper function to create directories for data (and any missing parents)
 void createDirectory(const std::string &dir) {
     struct stat info;
 
     if (stat(dir.c_str(), &info) != 0) {
         // Directory does not exist
+        size_t parentEnd = dir.find_last_of('/');
+        if (parentEnd != std::string::npos && parentEnd > 0) {
+            createDirectory(dir.substr(0, parentEnd));
+        }
         #ifdef _WIN32
             _mkdir(dir.c_str());
         #else
@@ -49,72 +56,101 @@ std::vector<std::string> tokenize(const std::string &text) {
     }
     return tokens;
 }
-extern void logMessage(const std::string &message);
-
-// Save term-docID pairs to a temp file
-void saveTermDocPairsToFile(const std::vector<TermDocPair> &termDocPairs, const int &fileCounter) {
-    // Sort the termDocPairs by term and docID
-    std::vector<TermDocPair> sortedPairs = termDocPairs;
-    std::sort(sortedPairs.begin(), sortedPairs.end(), [](const TermDocPair &a, const TermDocPair &b) {
-        if (a.term == b.term) {
-            return a.docID < b.docID;
-        }
-        return a.term < b.term;
-    });
-
-    // Create a new temp file
-    std::ofstream tempFile("../data/intermediate/temp" + std::to_string(fileCounter) + ".bin", std::ios::binary);
-    if (!tempFile.is_open()) {
-        logMessage("Error opening temp file for writing.");
-        return;
+// True if name is a plain decimal number that round-trips through uint32
+static bool isNumericName(const std::string &name, uint32_t &value) {
+    if (name.empty() || name.size() > 10 || (name.size() > 1 && name[0] == '0')) return false;
+    uint64_t number = 0;
+    for (char c : name) {
+        if (c < '0' || c > '9') return false;
+        number = number * 10 + (c - '0');
     }
-
-    // Write term-docID pairs to the file
-    for (const auto &pair : sortedPairs) {
-        uint16_t termLength = static_cast<uint16_t>(pair.term.length());
-        tempFile.write(reinterpret_cast<const char*>(&termLength), sizeof(termLength));
-        tempFile.write(pair.term.c_str(), termLength);
-        tempFile.write(reinterpret_cast<const char*>(&pair.docID), sizeof(pair.docID));
-        tempFile.write(reinterpret_cast<const char*>(&pair.termFScore), sizeof(pair.termFScore));
-    }
-
-    tempFile.close();
-    logMessage("Saved term-docID pairs to temp file.");
+    if (number > UINT32_MAX) return false;
+    value = static_cast<uint32_t>(number);
+    return true;
 }
-// Write the page table to a binary file
-void writePageTableToFile(const std::unordered_map<int, std::string> &pageTable) {
-    std::ofstream pageTableFile("../data/page_table.bin", std::ios::binary);
+
+// Write the page table as a dense docID-indexed array
+bool writePageTableToFile(const std::unordered_map<int, std::string> &pageTable, const std::string &filename) {
+    std::ofstream pageTableFile(filename, std::ios::binary);
     if (!pageTableFile.is_open()) {
-        logMessage("Error opening page table file for writing.");
-        return;
+        LOG_ERROR("Error opening page table file for writing.");
+        return false;
     }
 
+    // docIDs are handed out densely from 0
+    uint64_t docCount = 0;
     for (const auto &[docID, docName] : pageTable) {
-        // Write docID
-        pageTableFile.write(reinterpret_cast<const char*>(&docID), sizeof(docID));
+        docCount = std::max<uint64_t>(docCount, static_cast<uint64_t>(docID) + 1);
+    }
 
-        // Write docName length and docName
-        uint16_t nameLength = static_cast<uint16_t>(docName.length());
-        pageTableFile.write(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength));
-        pageTableFile.write(docName.c_str(), nameLength);
+    // MS MARCO passage names are integers; store them as ids when that holds for every document
+    std::vector<uint32_t> numericIDs(docCount, 0);
+    bool numeric = true;
+    for (const auto &[docID, docName] : pageTable) {
+        if (!isNumericName(docName, numericIDs[docID])) {
+            numeric = false;
+            break;
+        }
+    }
+    numeric = numeric && pageTable.size() == docCount;
+
+    PageTableHeader header = {PAGE_TABLE_MAGIC, numeric ? 1u : 0u, docCount};
+    pageTableFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    if (numeric) {
+        pageTableFile.write(reinterpret_cast<const char *>(numericIDs.data()), numericIDs.size() * sizeof(uint32_t));
+    } else {
+        std::vector<uint64_t> offsets(docCount + 1, 0);
+        for (uint64_t docID = 0; docID < docCount; ++docID) {
+            auto it = pageTable.find(static_cast<int>(docID));
+            offsets[docID + 1] = offsets[docID] + (it != pageTable.end() ? it->second.size() : 0);
+        }
+        pageTableFile.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        for (uint64_t docID = 0; docID < docCount; ++docID) {
+            auto it = pageTable.find(static_cast<int>(docID));
+            if (it != pageTable.end()) {
+                pageTableFile.write(it->second.data(), it->second.size());
+            }
+        }
     }
 
     pageTableFile.close();
-    logMessage("Page table written to file.");
+    if (!pageTableFile) {
+        LOG_ERROR("Error writing " + filename + ".");
+        return false;
+    }
+    LOG_INFO("Page table written to file.");
+    return true;
 }
 
-void writeDocLengthsToFile(const std::unordered_map<int, int> &docLengths) {
-    std::ofstream docLengthsFile("../data/doc_lengths.bin", std::ios::binary);
+// Write the document lengths as a dense docID-indexed array
+bool writeDocLengthsToFile(const std::unordered_map<int, int> &docLengths, const std::string &filename) {
+    std::ofstream docLengthsFile(filename, std::ios::binary);
     if (!docLengthsFile.is_open()) {
-        logMessage("Error opening doc_lengths.bin for writing.");
-        return;
+        LOG_ERROR("Error opening " + filename + " for writing.");
+        return false;
     }
 
+    uint64_t docCount = 0;
     for (const auto &[docID, docLength] : docLengths) {
-        docLengthsFile.write(reinterpret_cast<const char *>(&docID), sizeof(docID));
-        docLengthsFile.write(reinterpret_cast<const char *>(&docLength), sizeof(docLength));
+        docCount = std::max<uint64_t>(docCount, static_cast<uint64_t>(docID) + 1);
+    }
+    std::vector<int32_t> lengths(docCount, 0);
+    uint64_t totalLength = 0;
+    for (const auto &[docID, docLength] : docLengths) {
+        lengths[docID] = docLength;
+        totalLength += docLength;
     }
 
+    DocLengthsHeader header = {DOC_LENGTHS_MAGIC, 0, docCount, totalLength};
+    docLengthsFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    docLengthsFile.write(reinterpret_cast<const char *>(lengths.data()), lengths.size() * sizeof(int32_t));
+
     docLengthsFile.close();
-    logMessage("Document lengths written to doc_lengths.bin.");
+    if (!docLengthsFile) {
+        LOG_ERROR("Error writing " + filename + ".");
+        return false;
+    }
+    LOG_INFO("Document lengths written to " + filename + ".");
+    return true;
 }